@@ -0,0 +1,286 @@
+/*
+ * Per-sample kernels of the Surge XT plugin wrapper
+ *
+ * The loops the wrapper itself runs on every sample: the half-rate
+ * upsampler and the float to int16 output conversion with its optional
+ * soft clip, plus the FP mode switch around rendering. Header-only with
+ * no Surge dependency, so tests/kernel_tests can build them on their own.
+ *
+ * On aarch64 each kernel has a hand-written NEON variant next to the
+ * scalar one. Both are always compiled there, so the tests can compare
+ * them; the plugin uses NEON only when built with SURGE_MOVE_NEON_KERNELS.
+ * This covers the wrapper's loops only. Surge's own hot spots
+ * (oscillators, QuadFilterChain, waveshapers) are neither profiled nor
+ * vectorised here.
+ */
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#define DSP_KERNELS_HAVE_NEON 1
+#else
+#define DSP_KERNELS_HAVE_NEON 0
+#endif
+
+#if DSP_KERNELS_HAVE_NEON && defined(SURGE_MOVE_NEON_KERNELS)
+#define USE_NEON_KERNELS 1
+#else
+#define USE_NEON_KERNELS 0
+#endif
+
+/* =====================================================================
+ * Halfband 2x upsampler
+ *
+ * Odd phase of a Blackman-windowed halfband FIR, HALFBAND_TAPS
+ * coefficient pairs (4*HALFBAND_TAPS-1 taps overall). Roughly 70 dB image
+ * rejection above 0.45 of the input rate, with a latency of
+ * HALFBAND_TAPS + 1 input samples. Even output samples are the (delayed)
+ * input samples; odd ones are interpolated.
+ * ===================================================================== */
+
+#define HALFBAND_TAPS 16
+#define HALFBAND_HISTORY (HALFBAND_TAPS * 2)   /* hist needs this + n floats */
+
+static inline void halfband_design(float *coeffs) {
+    double sum = 0.0;
+    for (int k = 0; k < HALFBAND_TAPS; k++) {
+        double t = k + 0.5;                          /* distance from center, in input samples */
+        double d = t / HALFBAND_TAPS;                /* 0..1 across the window half */
+        double sinc = sin(M_PI * t) / (M_PI * t);
+        double win = 0.42 + 0.5 * cos(M_PI * d) + 0.08 * cos(2.0 * M_PI * d);
+        coeffs[k] = (float)(sinc * win);
+        sum += 2.0 * coeffs[k];
+    }
+    for (int k = 0; k < HALFBAND_TAPS; k++) coeffs[k] = (float)(coeffs[k] / sum);
+}
+
+/* n input samples to 2n output samples. hist holds HALFBAND_HISTORY + n
+ * floats, zeroed before the first call. */
+static inline void upsample_2x_scalar(const float *coeffs, float *hist,
+                                      const float *in, float *out, int n) {
+    memcpy(hist + HALFBAND_HISTORY, in, n * sizeof(float));
+    for (int i = 0; i < n; i++) {
+        /* Interpolate between hist[i + K - 1] and hist[i + K] */
+        const float *center = hist + i + HALFBAND_TAPS;
+        float acc = 0.0f;
+        for (int k = 0; k < HALFBAND_TAPS; k++) {
+            acc += coeffs[k] * (center[-1 - k] + center[k]);
+        }
+        out[2 * i] = center[-1];
+        out[2 * i + 1] = acc;
+    }
+    memmove(hist, hist + n, HALFBAND_HISTORY * sizeof(float));
+}
+
+#if DSP_KERNELS_HAVE_NEON
+/* n must be a multiple of 4. Four output pairs per step; each lane
+ * accumulates its taps in the same order as the scalar loop, but with
+ * fused multiply-adds, so results differ by float rounding only. */
+static inline void upsample_2x_neon(const float *coeffs, float *hist,
+                                    const float *in, float *out, int n) {
+    memcpy(hist + HALFBAND_HISTORY, in, n * sizeof(float));
+    for (int i = 0; i < n; i += 4) {
+        const float *center = hist + i + HALFBAND_TAPS;
+        float32x4_t acc = vdupq_n_f32(0.0f);
+        for (int k = 0; k < HALFBAND_TAPS; k++) {
+            float32x4_t pair = vaddq_f32(vld1q_f32(center - 1 - k), vld1q_f32(center + k));
+            acc = vfmaq_n_f32(acc, pair, coeffs[k]);
+        }
+        float32x4x2_t even_odd = { { vld1q_f32(center - 1), acc } };
+        vst2q_f32(out + 2 * i, even_odd);
+    }
+    memmove(hist, hist + n, HALFBAND_HISTORY * sizeof(float));
+}
+#endif
+
+static inline void upsample_2x(const float *coeffs, float *hist,
+                               const float *in, float *out, int n) {
+#if USE_NEON_KERNELS
+    upsample_2x_neon(coeffs, hist, in, out, n);
+#else
+    upsample_2x_scalar(coeffs, hist, in, out, n);
+#endif
+}
+
+/* =====================================================================
+ * Soft clip
+ *
+ * Samples above SOFT_CLIP_KNEE bend into full scale through tanh, which
+ * keeps the slope continuous at the knee.
+ * ===================================================================== */
+
+#define SOFT_CLIP_KNEE 0.75f
+#define FAST_TANH_CLAMP 4.97f   /* rational reaches 1 - 1e-6 here */
+
+/* tanh from Lambert's continued fraction truncated at [7/6]. Max abs
+ * error against tanh (checked by tests/kernel_tests): FAST_TANH_ERR_ALL
+ * over all inputs (at the clamp), FAST_TANH_ERR_4 for |x| < 4 and
+ * FAST_TANH_ERR_2 for |x| < 2. Only the output soft clip uses it; no
+ * Surge voice path can, so it saves no per-voice CPU. */
+#define FAST_TANH_ERR_ALL 9.6e-5f
+#define FAST_TANH_ERR_4 1.6e-5f
+#define FAST_TANH_ERR_2 2.2e-7f
+
+static inline float fast_tanh(float x) {
+    if (x > FAST_TANH_CLAMP) x = FAST_TANH_CLAMP;
+    if (x < -FAST_TANH_CLAMP) x = -FAST_TANH_CLAMP;
+    float x2 = x * x;
+    return x * (135135.0f + x2 * (17325.0f + x2 * (378.0f + x2))) /
+           (135135.0f + x2 * (62370.0f + x2 * (3150.0f + x2 * 28.0f)));
+}
+
+static inline float soft_clip_sample(float x) {
+    float ax = fabsf(x);
+    if (ax <= SOFT_CLIP_KNEE) return x;
+    const float span = 1.0f - SOFT_CLIP_KNEE;
+    float y = SOFT_CLIP_KNEE + span * fast_tanh((ax - SOFT_CLIP_KNEE) / span);
+    return copysignf(y, x);
+}
+
+#if DSP_KERNELS_HAVE_NEON
+static inline float32x4_t fast_tanh_neon(float32x4_t x) {
+    x = vminq_f32(vmaxq_f32(x, vdupq_n_f32(-FAST_TANH_CLAMP)), vdupq_n_f32(FAST_TANH_CLAMP));
+    float32x4_t x2 = vmulq_f32(x, x);
+    float32x4_t num = vfmaq_f32(vdupq_n_f32(378.0f), x2, vdupq_n_f32(1.0f));
+    num = vfmaq_f32(vdupq_n_f32(17325.0f), x2, num);
+    num = vfmaq_f32(vdupq_n_f32(135135.0f), x2, num);
+    float32x4_t den = vfmaq_f32(vdupq_n_f32(3150.0f), x2, vdupq_n_f32(28.0f));
+    den = vfmaq_f32(vdupq_n_f32(62370.0f), x2, den);
+    den = vfmaq_f32(vdupq_n_f32(135135.0f), x2, den);
+    return vdivq_f32(vmulq_f32(x, num), den);
+}
+
+static inline float32x4_t soft_clip_neon(float32x4_t x) {
+    const float span = 1.0f - SOFT_CLIP_KNEE;
+    float32x4_t ax = vabsq_f32(x);
+    float32x4_t over = vmulq_n_f32(vsubq_f32(ax, vdupq_n_f32(SOFT_CLIP_KNEE)), 1.0f / span);
+    float32x4_t y = vfmaq_n_f32(vdupq_n_f32(SOFT_CLIP_KNEE), fast_tanh_neon(over), span);
+    y = vbslq_f32(vcgtq_f32(ax, vdupq_n_f32(SOFT_CLIP_KNEE)), y, ax);
+    /* Put the input's sign back on */
+    uint32x4_t sign = vandq_u32(vreinterpretq_u32_f32(x), vdupq_n_u32(0x80000000u));
+    return vreinterpretq_f32_u32(vorrq_u32(vreinterpretq_u32_f32(y), sign));
+}
+#endif
+
+/* =====================================================================
+ * Output conversion
+ *
+ * Scale, convert and interleave to int16. Truncates toward zero and
+ * saturates.
+ * ===================================================================== */
+
+static inline void convert_to_int16_scalar(const float *src_l, const float *src_r, float gain,
+                                           bool soft_clip, int16_t *out, int frames) {
+    for (int i = 0; i < frames; i++) {
+        float left = src_l[i] * gain;
+        float right = src_r[i] * gain;
+        if (soft_clip) {
+            left = soft_clip_sample(left);
+            right = soft_clip_sample(right);
+        }
+
+        int32_t l = (int32_t)(left * 32767.0f);
+        int32_t r = (int32_t)(right * 32767.0f);
+        if (l > 32767) l = 32767;
+        if (l < -32768) l = -32768;
+        if (r > 32767) r = 32767;
+        if (r < -32768) r = -32768;
+
+        out[i * 2] = (int16_t)l;
+        out[i * 2 + 1] = (int16_t)r;
+    }
+}
+
+#if DSP_KERNELS_HAVE_NEON
+/* FCVTZS truncates like the C cast and SQXTN saturates like the clamp, so
+ * this is bit-exact with the scalar loop (soft clip aside, where lanes
+ * differ from it by float rounding only). A frames % 4 tail runs scalar. */
+static inline void convert_to_int16_neon(const float *src_l, const float *src_r, float gain,
+                                         bool soft_clip, int16_t *out, int frames) {
+    const float32x4_t g = vdupq_n_f32(gain);
+    const float32x4_t full_scale = vdupq_n_f32(32767.0f);
+    int i = 0;
+    for (; i + 4 <= frames; i += 4) {
+        float32x4_t l = vmulq_f32(vld1q_f32(src_l + i), g);
+        float32x4_t r = vmulq_f32(vld1q_f32(src_r + i), g);
+        if (soft_clip) {
+            l = soft_clip_neon(l);
+            r = soft_clip_neon(r);
+        }
+        l = vmulq_f32(l, full_scale);
+        r = vmulq_f32(r, full_scale);
+        int16x4x2_t lr = { { vqmovn_s32(vcvtq_s32_f32(l)), vqmovn_s32(vcvtq_s32_f32(r)) } };
+        vst2_s16(out + 2 * i, lr);
+    }
+    convert_to_int16_scalar(src_l + i, src_r + i, gain, soft_clip, out + 2 * i, frames - i);
+}
+#endif
+
+static inline void convert_to_int16(const float *src_l, const float *src_r, float gain,
+                                    bool soft_clip, int16_t *out, int frames) {
+#if USE_NEON_KERNELS
+    convert_to_int16_neon(src_l, src_r, gain, soft_clip, out, frames);
+#else
+    convert_to_int16_scalar(src_l, src_r, gain, soft_clip, out, frames);
+#endif
+}
+
+/* =====================================================================
+ * FP mode
+ *
+ * Flush-to-zero for the duration of a render, restoring the caller's
+ * mode afterwards: FPCR.FZ and FPCR.DN on aarch64, MXCSR FTZ and DAZ on
+ * x86. Other targets leave the mode alone (FP_MODE_FTZ_SUPPORTED 0).
+ * ===================================================================== */
+
+#if defined(__aarch64__) || defined(__SSE__)
+#define FP_MODE_FTZ_SUPPORTED 1
+#else
+#define FP_MODE_FTZ_SUPPORTED 0
+#endif
+
+/* Returns the previous mode for fp_mode_restore */
+static inline uint64_t fp_mode_enter_ftz(void) {
+#if defined(__aarch64__)
+    uint64_t fpcr;
+    __asm__ volatile("mrs %0, fpcr" : "=r"(fpcr));
+    uint64_t want = fpcr | (1ull << 24) | (1ull << 25);   /* FZ, DN */
+    if (want != fpcr) __asm__ volatile("msr fpcr, %0" : : "r"(want));
+    return fpcr;
+#elif defined(__SSE__)
+    unsigned int csr = _mm_getcsr();
+    _mm_setcsr(csr | 0x8040);                             /* FTZ, DAZ */
+    return csr;
+#else
+    return 0;
+#endif
+}
+
+static inline void fp_mode_restore(uint64_t saved) {
+#if defined(__aarch64__)
+    uint64_t fpcr;
+    __asm__ volatile("mrs %0, fpcr" : "=r"(fpcr));
+    if (fpcr != saved) __asm__ volatile("msr fpcr, %0" : : "r"(saved));
+#elif defined(__SSE__)
+    _mm_setcsr((unsigned int)saved);
+#else
+    (void)saved;
+#endif
+}
+
+static inline int count_subnormals(const float *x, int n) {
+    int count = 0;
+    for (int i = 0; i < n; i++) {
+        if (std::fpclassify(x[i]) == FP_SUBNORMAL) count++;
+    }
+    return count;
+}
@@ -12,9 +12,29 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <cctype>
 #include <cmath>
+#include <atomic>
+#include <chrono>
 #include <memory>
 #include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <algorithm>
+#include <filesystem>
+#include <time.h>
+#include <malloc.h>
+#include <poll.h>
+#include <strings.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/inotify.h>
+
+/* Upsampler, soft clip and int16 conversion, scalar and NEON, and the FP
+ * mode switch; SURGE_MOVE_NEON_KERNELS comes from CMake */
+#include "dsp_kernels.h"
 
 /* Plugin API definitions */
 extern "C" {
@@ -59,11 +79,13 @@ typedef plugin_api_v2_t* (*move_plugin_init_v2_fn)(const host_api_v1_t *host);
 #include "SurgeSynthesizer.h"
 #include "SurgeStorage.h"
 #include "Parameter.h"
+#include "SurgeVoice.h"
 
-/* Surge block size is 32, Move block size is 128, so we call process() 4 times */
-static_assert(MOVE_FRAMES_PER_BLOCK % BLOCK_SIZE == 0,
-    "Move block size must be a multiple of Surge block size");
-#define SURGE_CALLS_PER_MOVE_BLOCK (MOVE_FRAMES_PER_BLOCK / BLOCK_SIZE)
+/* Surge renders fixed BLOCK_SIZE (32) frame blocks. The host's block size
+ * (frames_per_block, 128 on Move) need not be a multiple of that, so
+ * rendered blocks are staged per instance and drained across render calls.
+ * MOVE_SAMPLE_RATE / MOVE_FRAMES_PER_BLOCK are only fallbacks for hosts
+ * that leave the host_api fields zero. */
 
 /* Host API reference */
 static const host_api_v1_t *g_host = nullptr;
@@ -72,10 +94,14 @@ static const host_api_v1_t *g_host = nullptr;
  * PluginLayer stub (required by SurgeSynthesizer)
  * ===================================================================== */
 
+/* Forwards Surge's parameter/macro change callbacks (MIDI CC, program
+ * change, automation) to the owning instances' dirty bitmaps. Callbacks may
+ * arrive on the audio thread, so they only set bits. */
 class MovePluginLayer : public SurgeSynthesizer::PluginLayer {
 public:
-    void surgeParameterUpdated(const SurgeSynthesizer::ID &, float) override {}
-    void surgeMacroUpdated(long, float) override {}
+    void *owners[n_scenes] = {};  /* surge_instance_t per part, [0] when standalone */
+    void surgeParameterUpdated(const SurgeSynthesizer::ID &id, float) override;
+    void surgeMacroUpdated(long id, float) override;
 };
 
 /* =====================================================================
@@ -83,6 +109,38 @@ public:
  * ===================================================================== */
 
 #define MAX_SURGE_PARAMS 300
+#define PARAM_HASH_SIZE 1024    /* power of two, > 2x MAX_SURGE_PARAMS */
+#define MAX_BATCH_PARAMS 512
+#define MAX_SYNTH_PARAMS 4096   /* bound on Surge's synth-side param ids */
+#define DIRTY_WORDS ((MAX_SURGE_PARAMS + 63) / 64)
+#define N_MACROS 8
+
+/* =====================================================================
+ * Control-path instrumentation (control_stats)
+ * ===================================================================== */
+
+enum {
+    CTL_SET,          /* set_param for a single key */
+    CTL_GET,          /* get_param for a single key */
+    CTL_STATE_SAVE,   /* get_param("state") */
+    CTL_STATE_LOAD,   /* set_param("state") */
+    CTL_JSON,         /* ui_hierarchy / chain_params retrieval */
+    CTL_BATCH,        /* set_param("params") */
+    CTL_KIND_COUNT
+};
+
+static const char *ctl_kind_names[CTL_KIND_COUNT] = {
+    "set", "get", "state_save", "state_load", "json", "batch"
+};
+
+#define CTL_HIST_BUCKETS 32   /* log2(ns) buckets, 1ns .. ~4s */
+
+struct ctl_stat {
+    uint64_t count;
+    uint64_t ns_total;
+    uint64_t ns_max;
+    uint32_t hist[CTL_HIST_BUCKETS];
+};
 
 struct surge_param_entry {
     char key[48];             /* Parameter key, e.g. "osc1_pitch" */
@@ -91,6 +149,203 @@ struct surge_param_entry {
     int valtype;              /* 0=int, 1=bool, 2=float */
 };
 
+/* Eco quality mode: unison parameters capped, with the patch's own values
+ * remembered so they can be restored and saved in state */
+#define MAX_ECO_ENTRIES (n_scenes * n_oscs)
+#define ECO_UNISON_CAP_DEFAULT 3
+
+struct eco_entry {
+    Parameter *param;
+    SurgeSynthesizer::ID surge_id;
+    float orig01;             /* patch value before capping */
+    int capped_to;
+};
+
+/* In-memory preset index over storage.patch_list in patchOrdering order,
+ * with a trie over the lowercased name and every word start within it, so
+ * preset_names / preset_search never touch the engine or disk. Indexes are
+ * immutable once published; the user patch watcher swaps in new ones. */
+struct preset_entry {
+    std::string name;
+    std::string category;
+    std::string path;
+    int raw_idx;              /* index into storage.patch_list, -1 = added by watcher */
+};
+
+struct preset_trie_node {
+    char ch;
+    int first_child;          /* -1 = none */
+    int next_sibling;         /* -1 = none */
+    int first_match;          /* head of match list in trie_matches, -1 = none */
+};
+
+struct preset_trie_match {
+    int preset;               /* display index */
+    int next;
+};
+
+struct preset_index {
+    uint32_t generation;
+    std::vector<preset_entry> entries;
+    std::vector<preset_trie_node> trie;   /* node 0 is the root */
+    std::vector<preset_trie_match> trie_matches;
+};
+
+#define MAX_SEARCH_RESULTS 64
+
+/* inotify watcher over the user patch directory tree */
+struct preset_watcher {
+    std::thread thread;
+    std::atomic<bool> stop{false};
+    int fd = -1;
+    std::string root;
+    std::vector<std::pair<int, std::string>> dirs;   /* watch descriptor -> directory */
+    std::vector<preset_index*> retired;              /* awaiting no readers */
+};
+
+/* Background patch saver. The control thread only queues the request;
+ * serialising, the file write, rename and fsync all happen on the saver
+ * thread. The live patch name, category and preset_name are changed on
+ * the control thread once the file is written. */
+struct patch_saver {
+    std::thread thread;
+    std::mutex mtx;
+    std::condition_variable cv;
+    bool stop = false;
+    bool requested = false;
+    std::string path;         /* target of the pending request */
+    std::string name, category;
+    uint32_t request_loads = 0;
+    bool saved = false;       /* written, rename not yet applied */
+    std::string saved_name, saved_category;
+    uint32_t saved_loads = 0;
+    size_t buffer_bytes = 0;  /* snapshot and bytes capacity, for memory_stats */
+    char status[600] = "idle";
+
+    /* Held by the saver while it reads the patch and by the control thread
+     * around patch loads (standalone instances; parts use mt_engine's) */
+    std::mutex patch_lock;
+    uint32_t loads = 0;       /* patch loads so far, written under patch_lock */
+    std::vector<pdata> snapshot;   /* saver thread scratch for the consistency check */
+    std::vector<uint8_t> bytes;    /* saver thread */
+};
+
+#define SAVE_ATTEMPTS 3
+
+/* Cached Surge display string per registry slot. Valid while the value
+ * and the instance's display generation are unchanged; the generation
+ * moves on patch loads and on changes to int params (types, modes), which
+ * can change how other params are displayed. */
+struct display_cache_entry {
+    float value;
+    uint32_t gen;             /* 0 = never filled */
+    char text[48];
+};
+
+/* Batched parameter changes handed from set_param("params") to the render
+ * thread, which applies the whole batch between two Surge blocks */
+struct batch_param {
+    SurgeSynthesizer::ID surge_id;
+    float value;
+};
+
+enum {
+    BATCH_EMPTY,
+    BATCH_READY,      /* filled, waiting for the next block boundary */
+    BATCH_APPLYING,   /* render thread is applying it */
+    BATCH_WRITING     /* control thread is filling or appending */
+};
+
+/* Keys shown on each ui_hierarchy level, resolved to registry slots so
+ * level_values can read a whole knob page in one pass */
+#define MAX_UI_LEVELS 24
+#define MAX_LEVEL_KEYS 40
+
+struct ui_level {
+    char name[16];
+    int key_count;
+    uint16_t key_offs[MAX_LEVEL_KEYS]; /* into the instance's level_key_pool */
+    int16_t slots[MAX_LEVEL_KEYS];   /* params index, -1 = module-level key */
+};
+
+/* Multitimbral engine shared by the instances of one mt_group. Each part
+ * plays one scene; the engine is processed once per Surge block and both
+ * scene outputs are kept in a small ring for the part that reads second. */
+#define MT_MAX_PARTS n_scenes
+#define MT_RING_BLOCKS 16
+#define MT_CHANNEL_SCENE_B 15     /* MIDI channel used for the part on scene B */
+
+struct mt_engine {
+    int group;
+    MovePluginLayer *plugin_layer;
+    SurgeSynthesizer *synth;
+    void *parts[MT_MAX_PARTS];        /* surge_instance_t, nullptr = free */
+    int part_scene[MT_MAX_PARTS];
+    std::mutex render_lock;           /* engine block production and patch loads */
+    std::mutex patch_lock;            /* patch saves against patch loads */
+    uint64_t produced;                /* Surge blocks rendered so far */
+    std::atomic<uint32_t> fx_bytes[n_fx_slots];   /* as surge_instance_t's */
+    float ring[MT_RING_BLOCKS][n_scenes][N_OUTPUTS][BLOCK_SIZE];
+};
+
+/* Process-wide render scheduler for instances created with
+ * "parallel_render": 1. One job per instance per host cycle. */
+#define MAX_SCHED_INSTANCES 16
+#define SCHED_MAX_WORKERS 3
+#define SCHED_MAX_FRAMES 1024
+#define MIDI_QUEUE_SIZE 256       /* power of two */
+#define PARAM_QUEUE_SIZE 1024     /* power of two, above MAX_BATCH_PARAMS */
+#define SCHED_BACKOFF_CYCLES 256  /* cycles an overrun instance renders inline */
+
+enum {
+    JOB_IDLE,         /* output collected, nothing pending */
+    JOB_QUEUED,       /* waiting for a worker (or its own render_block) */
+    JOB_RUNNING,
+    JOB_DONE          /* output ready in job_out */
+};
+
+struct render_scheduler {
+    std::mutex mtx;               /* slots, job claiming, worker lifetime */
+    std::condition_variable cv;
+    std::vector<std::thread> workers;
+    bool stop = false;
+    int registered = 0;
+    std::atomic<uint32_t> cycle{0};          /* host cycles started; stamps MIDI */
+    void *slots[MAX_SCHED_INSTANCES] = {};   /* surge_instance_t */
+};
+
+struct midi_event {
+    uint8_t data[3];
+    uint8_t len;
+    uint32_t stamp;           /* host or scheduler cycle it arrived in */
+};
+
+/* Surge param change from set_param, applied in the render timeline */
+struct param_event {
+    SurgeSynthesizer::ID surge_id;
+    float value;
+    uint32_t stamp;           /* as midi_event */
+};
+
+/* Render-ahead worker: renders the next host block into buf while the
+ * host plays the previous one */
+struct render_ahead {
+    std::thread thread;
+    std::mutex mtx;
+    std::condition_variable cv;
+    bool stop = false;
+    bool pending = false;     /* a block was requested, guarded by mtx */
+    std::atomic<bool> busy{false};   /* requested block not finished yet */
+    std::atomic<int> cancel{0};      /* stop the worker at the next Surge block */
+    bool primed = false;      /* buf holds a rendered block */
+    int frames = 0;
+    int rendered = 0;         /* frames of buf the worker filled */
+    uint32_t cycle = 0;       /* host cycle the block is requested in */
+    uint64_t late = 0;        /* render_block had to wait for the worker */
+    uint64_t overruns = 0;    /* ... and finished the block itself */
+    int16_t buf[SCHED_MAX_FRAMES * 2];
+};
+
 /* =====================================================================
  * Instance structure
  * ===================================================================== */
@@ -102,19 +357,159 @@ typedef struct {
     MovePluginLayer *plugin_layer;
     SurgeSynthesizer *synth;
 
+    /* Audio configuration taken from the host at creation */
+    int sample_rate;
+    int host_frames_per_block;
+
+    /* Rendered Surge block not yet handed to the host (2x when half-rate) */
+    float block_out[2][BLOCK_SIZE * 2];
+    int block_len;
+    int block_pos;
+
+    /* Half-rate engine with 2x polyphase upsampling to the host rate.
+     * Switched by the control thread while it holds the engine. */
+    int half_rate;
+    float upsample_hist[2][HALFBAND_HISTORY + BLOCK_SIZE];
+
     int current_preset;
-    int preset_count;
+    uint32_t current_preset_gen;      /* index generation current_preset refers to */
+    char current_preset_path[512];
+
+    /* Published preset index; readers bracket access with preset_readers */
+    std::atomic<preset_index*> presets;
+    std::atomic<int> preset_readers;
+    preset_watcher *watcher;
+    patch_saver *saver;
+
+    /* MIDI program change, loaded from the wrapper index by the control
+     * thread: bank from CC 0, request as bank * 128 + program, -1 = none */
+    int midi_bank;
+    std::atomic<int> pending_program;
+
     int octave_transpose;
     float output_gain;
+    int soft_clip;            /* tanh knee above SOFT_CLIP_KNEE instead of hard clip */
     char preset_name[64];
 
     /* Dynamic parameter registry */
     surge_param_entry params[MAX_SURGE_PARAMS];
     int param_count;
+    int16_t param_hash[PARAM_HASH_SIZE];   /* key hash -> params index, -1 = empty */
+
+    /* Change notification: synth-side id -> registry slot, and bits set by
+     * MovePluginLayer until the next changed_params poll */
+    int16_t synth_to_slot[MAX_SYNTH_PARAMS];
+    std::atomic<uint64_t> dirty[DIRTY_WORDS];
+    std::atomic<uint32_t> macro_dirty;
+    std::atomic<int> all_dirty;
+    int dirty_resume;                 /* slot an unfinished all sweep resumes at, -1 = none */
+    int notify_patchid;
+
+    /* Display strings for display:<key> and level_values */
+    display_cache_entry display_cache[MAX_SURGE_PARAMS];
+    std::atomic<uint32_t> display_gen;
+
+    /* Pending batch from set_param("params") */
+    std::atomic<int> batch_state;
+    batch_param batch[MAX_BATCH_PARAMS];
+    int batch_count;
 
     /* Pre-built JSON strings */
     char *ui_hierarchy_json;
     char *chain_params_json;
+    size_t json_bytes;        /* allocated for the two above (memory_stats) */
+
+    /* Per-level key lists parsed from ui_hierarchy_json */
+    ui_level ui_levels[MAX_UI_LEVELS];
+    int ui_level_count;
+    char *level_key_pool;     /* NUL-separated keys, sized to fit */
+    int level_key_pool_len;
+
+    /* Render instrumentation (render_stats) */
+    uint64_t render_calls;
+    uint64_t render_frames;
+    uint64_t render_ns_total;
+    uint64_t render_ns_max;
+    uint32_t output_hash;     /* FNV-1a over all rendered int16 samples */
+
+    /* Control-path instrumentation (control_stats), off unless enabled */
+    int ctl_timing;
+    ctl_stat ctl_stats[CTL_KIND_COUNT];
+
+    /* Voice stealing */
+    int quiet_steal;          /* 1 = steal the least audible voice ourselves */
+    uint64_t voice_steals;
+
+    /* Inaudible release tail culling */
+    int tail_cull;
+    float tail_threshold_db;  /* relative to int16 full scale */
+    float tail_threshold;     /* linear version of the above */
+    uint64_t voice_blocks;    /* voice x Surge-block count actually rendered */
+    uint64_t scene_blocks[n_scenes]; /* Surge blocks with voices in each scene */
+    uint64_t dual_scene_blocks;      /* ... with voices in both at once */
+    uint64_t tails_culled;
+    uint64_t tail_blocks_saved; /* estimated release blocks skipped */
+
+    /* Denormal protection and sampling (denormal_stats) */
+    int ftz;                  /* flush-to-zero / default-NaN while rendering */
+    uint32_t denormal_tick;   /* Surge blocks since creation */
+    uint64_t denormal_checks; /* blocks sampled */
+    uint64_t denormals_seen;  /* subnormal output samples in sampled blocks */
+
+    /* Effect sizes for memory_stats, sampled by the render thread (the
+     * mt_engine's copy for a multitimbral part) */
+    uint32_t fx_tick;
+    std::atomic<uint32_t> fx_bytes[n_fx_slots];
+
+    /* Quality mode */
+    int eco_mode;
+    int eco_unison_cap;
+    eco_entry eco[MAX_ECO_ENTRIES];
+    int eco_count;
+    int eco_patchid;          /* synth->patchid the entries were taken from */
+
+    /* Render scheduler job (sched_slot < 0 when not registered). MIDI is
+     * queued and applied by whichever thread runs the job. */
+    int sched_slot;
+    std::atomic<int> job_state;
+    int job_frames;
+    uint32_t job_cycle;       /* scheduler cycle the job renders for */
+    uint32_t sched_seen;      /* last scheduler cycle this instance rendered in */
+    std::atomic<int> job_cancel;      /* stop the worker at the next Surge block */
+    int job_rendered;         /* frames of job_out the job filled */
+    std::atomic<int> sched_backoff;   /* cycles left rendering inline after an overrun */
+    int16_t *job_out;         /* SCHED_MAX_FRAMES stereo frames, while registered */
+    midi_event *midi_queue;   /* MIDI_QUEUE_SIZE entries, allocated with sched/ahead */
+    std::atomic<uint32_t> midi_head;  /* written by on_midi */
+    std::atomic<uint32_t> midi_tail;  /* written by the job runner */
+    uint64_t midi_dropped;
+    param_event *param_queue; /* PARAM_QUEUE_SIZE entries, allocated with the MIDI queue */
+    std::atomic<uint32_t> param_head;   /* written by set_param */
+    std::atomic<uint32_t> param_tail;   /* written by the job runner */
+    uint64_t params_rejected; /* param changes dropped because the queue was full */
+    uint64_t jobs_self;       /* rendered by the instance's own render_block */
+    uint64_t jobs_worker;     /* rendered ahead by a pool worker */
+    uint64_t job_waits;       /* render_block found its job still running */
+    uint64_t job_timeouts;    /* ... and overran, so the rest was rendered inline */
+    uint64_t jobs_discarded;  /* finished for a cycle the host skipped this track in */
+
+    /* Render-ahead mode (ahead == nullptr when off) */
+    render_ahead *ahead;
+    std::atomic<uint32_t> host_cycle;   /* render_block calls so far */
+
+    /* Multitimbral part (mt == nullptr for a standalone instance) */
+    mt_engine *mt;
+    int mt_part;
+    uint64_t mt_consumed;     /* engine blocks read by this part */
+    uint64_t mt_blocks_skipped;
+    uint64_t mt_lock_misses;  /* silent blocks while a patch load held the engine */
+
+    /* Control-thread engine hold (standalone instances): the render path
+     * marks engine_busy around each Surge block and skips the engine while
+     * engine_hold is set */
+    std::atomic<int> engine_hold;     /* nesting count */
+    std::atomic<int> engine_busy;
+    uint64_t held_blocks;     /* silent blocks while the control thread held the engine */
 } surge_instance_t;
 
 /* =====================================================================
@@ -129,6 +524,77 @@ static void plugin_log(const char *msg) {
     }
 }
 
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+#define FNV1A_OFFSET 2166136261u
+#define FNV1A_PRIME 16777619u
+
+static void reset_render_stats(surge_instance_t *inst) {
+    inst->render_calls = 0;
+    inst->render_frames = 0;
+    inst->render_ns_total = 0;
+    inst->render_ns_max = 0;
+    inst->output_hash = FNV1A_OFFSET;
+    inst->denormal_checks = 0;
+    inst->denormals_seen = 0;
+    inst->held_blocks = 0;
+}
+
+static void record_ctl_stat(surge_instance_t *inst, int kind, uint64_t dt) {
+    ctl_stat *st = &inst->ctl_stats[kind];
+    st->count++;
+    st->ns_total += dt;
+    if (dt > st->ns_max) st->ns_max = dt;
+
+    int bucket = 0;
+    while (bucket < CTL_HIST_BUCKETS - 1 && (dt >> (bucket + 1)) != 0) bucket++;
+    st->hist[bucket]++;
+}
+
+/* Upper bound (in ns) of the histogram bucket containing the given percentile */
+static uint64_t ctl_stat_percentile(const ctl_stat *st, double pct) {
+    if (st->count == 0) return 0;
+    uint64_t target = (uint64_t)ceil((double)st->count * pct / 100.0);
+    uint64_t seen = 0;
+    for (int b = 0; b < CTL_HIST_BUCKETS; b++) {
+        seen += st->hist[b];
+        if (seen >= target) return (2ull << b) - 1;
+    }
+    return st->ns_max;
+}
+
+static int format_ctl_stats(surge_instance_t *inst, char *buf, int buf_len) {
+    int offset = snprintf(buf, buf_len, "{");
+    for (int k = 0; k < CTL_KIND_COUNT && offset < buf_len - 160; k++) {
+        const ctl_stat *st = &inst->ctl_stats[k];
+        double avg_us = st->count ? (double)st->ns_total / (double)st->count / 1000.0 : 0.0;
+        offset += snprintf(buf + offset, buf_len - offset,
+            "%s\"%s\":{\"count\":%llu,\"avg_us\":%.2f,\"p99_us\":%.2f,\"max_us\":%.2f}",
+            k ? "," : "", ctl_kind_names[k],
+            (unsigned long long)st->count, avg_us,
+            (double)ctl_stat_percentile(st, 99.0) / 1000.0,
+            (double)st->ns_max / 1000.0);
+    }
+    offset += snprintf(buf + offset, buf_len - offset, "}");
+    return offset;
+}
+
+/* Copy a display string into JSON, escaping quotes and backslashes */
+static int json_escape(char *out, int out_len, const char *in) {
+    int n = 0;
+    for (; *in && n < out_len - 2; in++) {
+        if (*in == '"' || *in == '\\') out[n++] = '\\';
+        else if ((uint8_t)*in < 0x20) continue;
+        out[n++] = *in;
+    }
+    out[n] = '\0';
+    return n;
+}
+
 static int json_get_number(const char *json, const char *key, float *out) {
     char search[64];
     snprintf(search, sizeof(search), "\"%s\":", key);
@@ -140,98 +606,1170 @@ static int json_get_number(const char *json, const char *key, float *out) {
     return 0;
 }
 
+static uint32_t hash_key(const char *key) {
+    uint32_t h = FNV1A_OFFSET;
+    while (*key) h = (h ^ (uint8_t)*key++) * FNV1A_PRIME;
+    return h;
+}
+
 /* =====================================================================
  * Parameter registry population
  * ===================================================================== */
 
+static surge_param_entry* find_param(surge_instance_t *inst, const char *key);
+
+static inline const char* level_key(const surge_instance_t *inst, const ui_level *level, int k) {
+    return inst->level_key_pool + level->key_offs[k];
+}
+
+/* Registry slots move when a patch loads, so level key lists are
+ * re-resolved after every populate_param_registry */
+static void resolve_level_slots(surge_instance_t *inst) {
+    for (int l = 0; l < inst->ui_level_count; l++) {
+        ui_level *level = &inst->ui_levels[l];
+        for (int k = 0; k < level->key_count; k++) {
+            surge_param_entry *entry = find_param(inst, level_key(inst, level, k));
+            level->slots[k] = entry ? (int16_t)(entry - inst->params) : -1;
+        }
+    }
+}
+
+/* Scene an instance's registry and notes map to: A unless it is a
+ * multitimbral part that was given scene B */
+static int part_scene(const surge_instance_t *inst) {
+    return inst->mt ? inst->mt->part_scene[inst->mt_part] : 0;
+}
+
 static void populate_param_registry(surge_instance_t *inst) {
     if (!inst->synth) return;
 
     auto &patch = inst->synth->storage.getPatch();
     int n_params = (int)patch.param_ptr.size();
+    int scene = part_scene(inst);
     inst->param_count = 0;
 
     for (int i = 0; i < n_params && inst->param_count < MAX_SURGE_PARAMS; i++) {
         Parameter *p = patch.param_ptr[i];
         if (!p) continue;
-        if (p->scene != 1) continue; /* Scene A only */
+        if (p->scene != scene + 1) continue; /* Scene A only (or the part's scene) */
 
         SurgeSynthesizer::ID id;
         if (!inst->synth->fromSynthSideId(i, id)) continue;
 
         surge_param_entry *entry = &inst->params[inst->param_count];
 
-        /* Key = storage name minus "a_" prefix */
-        const char *sname = p->get_storage_name();
-        if (sname[0] == 'a' && sname[1] == '_') {
-            strncpy(entry->key, sname + 2, sizeof(entry->key) - 1);
+        /* Key = storage name minus "a_" (or "b_") prefix */
+        const char *sname = p->get_storage_name();
+        if (sname[0] == 'a' + scene && sname[1] == '_') {
+            strncpy(entry->key, sname + 2, sizeof(entry->key) - 1);
+        } else {
+            strncpy(entry->key, sname, sizeof(entry->key) - 1);
+        }
+        entry->key[sizeof(entry->key) - 1] = '\0';
+
+        /* Display name from full name */
+        const char *fname = p->get_full_name();
+        strncpy(entry->display_name, fname, sizeof(entry->display_name) - 1);
+        entry->display_name[sizeof(entry->display_name) - 1] = '\0';
+
+        entry->surge_id = id;
+        entry->valtype = p->valtype;
+
+        inst->param_count++;
+    }
+
+    /* Reverse map for change notifications */
+    memset(inst->synth_to_slot, 0xff, sizeof(inst->synth_to_slot));
+    for (int i = 0; i < inst->param_count; i++) {
+        int sid = inst->params[i].surge_id.getSynthSideId();
+        if (sid >= 0 && sid < MAX_SYNTH_PARAMS) inst->synth_to_slot[sid] = (int16_t)i;
+    }
+    inst->all_dirty.store(1, std::memory_order_release);
+    inst->display_gen.fetch_add(1, std::memory_order_release);
+
+    /* Hash index for find_param */
+    memset(inst->param_hash, 0xff, sizeof(inst->param_hash));
+    for (int i = 0; i < inst->param_count; i++) {
+        uint32_t h = hash_key(inst->params[i].key) & (PARAM_HASH_SIZE - 1);
+        while (inst->param_hash[h] >= 0) h = (h + 1) & (PARAM_HASH_SIZE - 1);
+        inst->param_hash[h] = (int16_t)i;
+    }
+
+    resolve_level_slots(inst);
+
+    char msg[128];
+    snprintf(msg, sizeof(msg), "Registered %d Scene %c parameters",
+             inst->param_count, 'A' + scene);
+    plugin_log(msg);
+}
+
+/* Find a parameter entry by key */
+static surge_param_entry* find_param(surge_instance_t *inst, const char *key) {
+    uint32_t h = hash_key(key) & (PARAM_HASH_SIZE - 1);
+    while (inst->param_hash[h] >= 0) {
+        surge_param_entry *entry = &inst->params[inst->param_hash[h]];
+        if (strcmp(entry->key, key) == 0) return entry;
+        h = (h + 1) & (PARAM_HASH_SIZE - 1);
+    }
+    return nullptr;
+}
+
+/* =====================================================================
+ * Eco quality mode
+ *
+ * Unison is by far the largest per-voice multiplier in Surge patches, so
+ * eco mode caps every unison voice count parameter in both scenes (only
+ * its own scene for a multitimbral part). The patch's own values are kept
+ * in inst->eco so leaving eco mode (or saving state) gives back the
+ * original sound. Safe to call repeatedly: entries
+ * whose value was changed since capping pick up the new value.
+ *
+ * The table belongs to the control thread. Batched values are capped
+ * when queued, and a patch Surge loads on the render thread from its
+ * patch queue is noticed through patchid on the next control call,
+ * which drops the old patch's entries before anything restores them.
+ * ===================================================================== */
+
+static eco_entry* find_eco_entry(surge_instance_t *inst, const Parameter *p) {
+    for (int i = 0; i < inst->eco_count; i++) {
+        if (inst->eco[i].param == p) return &inst->eco[i];
+    }
+    return nullptr;
+}
+
+/* Entries taken from another patch would restore its values */
+static void eco_check_patch(surge_instance_t *inst) {
+    if (inst->synth->patchid == inst->eco_patchid) return;
+    inst->eco_patchid = inst->synth->patchid;
+    inst->eco_count = 0;
+}
+
+static void eco_apply(surge_instance_t *inst) {
+    if (!inst->synth) return;
+    auto &patch = inst->synth->storage.getPatch();
+    eco_check_patch(inst);
+
+    for (int sc = 0; sc < n_scenes; sc++) {
+        if (inst->mt && sc != part_scene(inst)) continue; /* other part's scene */
+        for (int o = 0; o < n_oscs; o++) {
+            for (int k = 0; k < n_osc_params; k++) {
+                Parameter *p = &patch.scene[sc].osc[o].p[k];
+                if (p->ctrltype != ct_osccount) continue;
+
+                SurgeSynthesizer::ID id;
+                if (!inst->synth->fromSynthSideId(p->id, id)) continue;
+
+                eco_entry *e = find_eco_entry(inst, p);
+                if (e && p->val.i == e->capped_to) continue;
+                if (e) {
+                    /* Changed since we capped it - that's the new patch value */
+                    e->orig01 = inst->synth->getParameter01(id);
+                } else {
+                    if (p->val.i <= inst->eco_unison_cap) continue;
+                    if (inst->eco_count >= MAX_ECO_ENTRIES) continue;
+                    e = &inst->eco[inst->eco_count++];
+                    e->param = p;
+                    e->surge_id = id;
+                    e->orig01 = inst->synth->getParameter01(id);
+                }
+
+                int capped = p->val.i;
+                if (capped > inst->eco_unison_cap) capped = inst->eco_unison_cap;
+                e->capped_to = capped;
+                if (capped != p->val.i) {
+                    inst->synth->setParameter01(id, p->value_to_normalized((float)capped));
+                }
+            }
+        }
+    }
+}
+
+static void eco_restore(surge_instance_t *inst) {
+    eco_check_patch(inst);
+    for (int i = 0; i < inst->eco_count; i++) {
+        eco_entry *e = &inst->eco[i];
+        if (e->param->val.i == e->capped_to) {
+            inst->synth->setParameter01(e->surge_id, e->orig01);
+        }
+    }
+    inst->eco_count = 0;
+}
+
+static void load_preset_by_display_index(surge_instance_t *inst, int display_idx);
+
+/* Before every control call: load a MIDI program change */
+static void load_pending_program(surge_instance_t *inst) {
+    int program = inst->pending_program.exchange(-1, std::memory_order_acquire);
+    if (program < 0 || !inst->synth) return;
+    load_preset_by_display_index(inst, program);
+}
+
+/* Before every control call: cap a patch Surge loaded by itself */
+static void eco_follow_patch(surge_instance_t *inst) {
+    if (inst->eco_mode && inst->synth && inst->synth->patchid != inst->eco_patchid) {
+        eco_apply(inst);
+    }
+}
+
+/* Value to send for a registered param about to be set to v01. A unison
+ * count above the cap is recorded as the patch value and sent capped, so
+ * sets queued for the render thread never need eco_apply there. */
+static float eco_cap_value(surge_instance_t *inst, const surge_param_entry *entry, float v01) {
+    if (!inst->eco_mode) return v01;
+    auto &patch = inst->synth->storage.getPatch();
+    int sid = entry->surge_id.getSynthSideId();
+    if (sid < 0 || sid >= (int)patch.param_ptr.size()) return v01;
+    Parameter *p = patch.param_ptr[sid];
+    if (!p || p->ctrltype != ct_osccount) return v01;
+    eco_check_patch(inst);
+
+    int count = (int)lroundf(p->normalized_to_value(v01));
+    eco_entry *e = find_eco_entry(inst, p);
+    if (count <= inst->eco_unison_cap) {
+        if (e) {
+            e->orig01 = v01;
+            e->capped_to = count;
+        }
+        return v01;
+    }
+    if (!e) {
+        if (inst->eco_count >= MAX_ECO_ENTRIES) return v01;
+        e = &inst->eco[inst->eco_count++];
+        e->param = p;
+        e->surge_id = entry->surge_id;
+    }
+    e->orig01 = v01;
+    e->capped_to = inst->eco_unison_cap;
+    return p->value_to_normalized((float)inst->eco_unison_cap);
+}
+
+/* Patch value of a registered param, ignoring eco mode's unison cap */
+static float get_patch_value01(surge_instance_t *inst, const surge_param_entry *entry) {
+    int synth_id = entry->surge_id.getSynthSideId();
+    eco_check_patch(inst);
+    for (int i = 0; i < inst->eco_count; i++) {
+        if (inst->eco[i].surge_id.getSynthSideId() == synth_id) return inst->eco[i].orig01;
+    }
+    return inst->synth->getParameter01(entry->surge_id);
+}
+
+/* =====================================================================
+ * Change notification
+ * ===================================================================== */
+
+void MovePluginLayer::surgeParameterUpdated(const SurgeSynthesizer::ID &id, float) {
+    int sid = id.getSynthSideId();
+    if (sid < 0 || sid >= MAX_SYNTH_PARAMS) return;
+
+    /* Multitimbral parts register different scenes, so at most one of
+     * them has a slot for a scene param */
+    for (int i = 0; i < n_scenes; i++) {
+        surge_instance_t *inst = (surge_instance_t*)owners[i];
+        if (!inst) continue;
+        int slot = inst->synth_to_slot[sid];
+        if (slot < 0) continue;
+        inst->dirty[slot >> 6].fetch_or(1ull << (slot & 63), std::memory_order_release);
+        if (inst->params[slot].valtype != 2) inst->display_gen.fetch_add(1, std::memory_order_release);
+    }
+}
+
+/* Display string for a registered param, formatted by Surge only when the
+ * value (or display generation) changed since the last call */
+static const char* get_display_cached(surge_instance_t *inst, int slot, float *value_out) {
+    const surge_param_entry *entry = &inst->params[slot];
+    display_cache_entry *dc = &inst->display_cache[slot];
+    float v = inst->synth->getParameter01(entry->surge_id);
+    uint32_t gen = inst->display_gen.load(std::memory_order_acquire);
+
+    if (dc->gen != gen || dc->value != v) {
+        char text[TXT_SIZE];
+        text[0] = '\0';
+        inst->synth->getParameterDisplay(entry->surge_id, text);
+        strncpy(dc->text, text, sizeof(dc->text) - 1);
+        dc->text[sizeof(dc->text) - 1] = '\0';
+        dc->value = v;
+        dc->gen = gen;
+    }
+    if (value_out) *value_out = v;
+    return dc->text;
+}
+
+void MovePluginLayer::surgeMacroUpdated(long id, float) {
+    if (id < 0 || id >= N_MACROS) return;
+    for (int i = 0; i < n_scenes; i++) {
+        surge_instance_t *inst = (surge_instance_t*)owners[i];
+        if (inst) inst->macro_dirty.fetch_or(1u << id, std::memory_order_release);
+    }
+}
+
+/* Keys and values changed since the last poll, as a JSON object.
+ * Bits that don't fit in the buffer are put back for the next poll; an
+ * all-params sweep that doesn't fit continues where it stopped, so every
+ * slot is reported even when the registry is larger than one reply. */
+static int format_changed_params(surge_instance_t *inst, char *buf, int buf_len) {
+    int offset = snprintf(buf, buf_len, "{");
+    int start = inst->dirty_resume;
+    if (inst->all_dirty.exchange(0, std::memory_order_acquire)) start = 0;
+    bool all = start >= 0;
+    bool full = false;
+
+    for (int w = 0; w < DIRTY_WORDS && !full; w++) {
+        uint64_t bits = inst->dirty[w].exchange(0, std::memory_order_acquire);
+        if (all) {
+            /* Sweep slots [start, param_count) plus anything changed below */
+            int lo = start - w * 64;
+            int hi = inst->param_count - w * 64;
+            uint64_t sweep = (hi >= 64) ? ~0ull : (hi > 0 ? (1ull << hi) - 1 : 0);
+            if (lo >= 64) sweep = 0;
+            else if (lo > 0) sweep &= ~((1ull << lo) - 1);
+            bits |= sweep;
+        }
+        while (bits) {
+            int b = __builtin_ctzll(bits);
+            int slot = w * 64 + b;
+            if (slot >= inst->param_count) break;
+            float v = get_patch_value01(inst, &inst->params[slot]);
+            int n = snprintf(buf + offset, buf_len - offset, "%s\"%s\":%.6f",
+                             offset > 1 ? "," : "", inst->params[slot].key, v);
+            if (n >= buf_len - offset - 2) {
+                buf[offset] = '\0';
+                /* Slots from here on are covered by the resumed sweep */
+                if (all) inst->dirty_resume = slot;
+                else inst->dirty[w].fetch_or(bits, std::memory_order_release);
+                full = true;
+                break;
+            }
+            offset += n;
+            bits &= bits - 1;
+        }
+    }
+    if (all && !full) inst->dirty_resume = -1;
+
+    uint32_t macros = full ? 0 : inst->macro_dirty.exchange(0, std::memory_order_acquire);
+    for (int m = 0; m < N_MACROS && inst->synth; m++) {
+        if (!(macros & (1u << m))) continue;
+        int n = snprintf(buf + offset, buf_len - offset, "%s\"macro%d\":%.6f",
+                         offset > 1 ? "," : "", m + 1,
+                         inst->synth->getMacroParameter01(m));
+        if (n >= buf_len - offset - 2) {
+            buf[offset] = '\0';
+            inst->macro_dirty.fetch_or(macros & ~((1u << m) - 1), std::memory_order_release);
+            break;
+        }
+        offset += n;
+    }
+
+    offset += snprintf(buf + offset, buf_len - offset, "}");
+    return offset;
+}
+
+/* =====================================================================
+ * Preset index
+ * ===================================================================== */
+
+static int trie_child(preset_index *idx, int node, char ch, bool create) {
+    int prev = -1;
+    for (int c = idx->trie[node].first_child; c >= 0; c = idx->trie[c].next_sibling) {
+        if (idx->trie[c].ch == ch) return c;
+        prev = c;
+    }
+    if (!create) return -1;
+
+    preset_trie_node n = { ch, -1, -1, -1 };
+    idx->trie.push_back(n);
+    int created = (int)idx->trie.size() - 1;
+    if (prev < 0) idx->trie[node].first_child = created;
+    else idx->trie[prev].next_sibling = created;
+    return created;
+}
+
+static void trie_insert(preset_index *idx, const char *text, int preset) {
+    int node = 0;
+    for (const char *c = text; *c; c++) {
+        node = trie_child(idx, node, (char)tolower((unsigned char)*c), true);
+    }
+    preset_trie_match m = { preset, idx->trie[node].first_match };
+    idx->trie_matches.push_back(m);
+    idx->trie[node].first_match = (int)idx->trie_matches.size() - 1;
+}
+
+static void build_preset_trie(preset_index *idx) {
+    idx->trie.clear();
+    idx->trie_matches.clear();
+    preset_trie_node root = { 0, -1, -1, -1 };
+    idx->trie.push_back(root);
+
+    /* Index the whole name plus each word start, so "bass" finds "Acid Bass" */
+    for (int i = 0; i < (int)idx->entries.size(); i++) {
+        const char *name = idx->entries[i].name.c_str();
+        for (const char *w = name; *w; w++) {
+            if (w == name || (w[-1] == ' ' && *w != ' ')) trie_insert(idx, w, i);
+        }
+    }
+}
+
+static preset_index* build_preset_index(SurgeStorage &storage) {
+    preset_index *idx = new preset_index();
+    idx->generation = 0;
+    idx->entries.reserve(storage.patchOrdering.size());
+
+    for (int raw : storage.patchOrdering) {
+        if (raw < 0 || raw >= (int)storage.patch_list.size()) continue;
+        const Patch &patch = storage.patch_list[raw];
+        preset_entry e;
+        e.name = patch.name;
+        if (patch.category >= 0 && patch.category < (int)storage.patch_category.size())
+            e.category = storage.patch_category[patch.category].name;
+        e.path = patch.path.string();
+        e.raw_idx = raw;
+        idx->entries.push_back(e);
+    }
+
+    build_preset_trie(idx);
+    return idx;
+}
+
+/* Pin the published index for the duration of a control-path access. The
+ * watcher only frees a retired index once no reader is active. */
+static preset_index* acquire_presets(surge_instance_t *inst) {
+    inst->preset_readers.fetch_add(1);
+    return inst->presets.load();
+}
+
+static void release_presets(surge_instance_t *inst) {
+    inst->preset_readers.fetch_sub(1);
+}
+
+static int get_preset_count(surge_instance_t *inst) {
+    preset_index *idx = acquire_presets(inst);
+    int count = idx ? (int)idx->entries.size() : 0;
+    release_presets(inst);
+    return count;
+}
+
+/* Keep current_preset pointing at the same patch after the watcher
+ * inserted or removed entries before it */
+static void sync_current_preset(surge_instance_t *inst, preset_index *idx) {
+    if (!idx || idx->generation == inst->current_preset_gen) return;
+    inst->current_preset_gen = idx->generation;
+    for (int i = 0; i < (int)idx->entries.size(); i++) {
+        if (idx->entries[i].path == inst->current_preset_path) {
+            inst->current_preset = i;
+            return;
+        }
+    }
+}
+
+/* Display indices of presets with a word starting with prefix, ascending */
+static int search_preset_index(preset_index *idx, const char *prefix, int *out, int max_out) {
+    int node = 0;
+    for (const char *c = prefix; *c && node >= 0; c++) {
+        node = trie_child(idx, node, (char)tolower((unsigned char)*c), false);
+    }
+    if (node < 0) return 0;
+
+    std::vector<int> found;
+    std::vector<int> stack;
+    stack.push_back(node);
+    while (!stack.empty()) {
+        int n = stack.back();
+        stack.pop_back();
+        for (int m = idx->trie[n].first_match; m >= 0; m = idx->trie_matches[m].next) {
+            found.push_back(idx->trie_matches[m].preset);
+        }
+        for (int c = idx->trie[n].first_child; c >= 0; c = idx->trie[c].next_sibling) {
+            stack.push_back(c);
+        }
+    }
+
+    std::sort(found.begin(), found.end());
+    found.erase(std::unique(found.begin(), found.end()), found.end());
+    int count = std::min((int)found.size(), max_out);
+    for (int i = 0; i < count; i++) out[i] = found[i];
+    return count;
+}
+
+static int format_preset_entries(preset_index *idx, const int *ids, int count,
+                                 char *buf, int buf_len) {
+    int offset = snprintf(buf, buf_len, "[");
+    for (int i = 0; i < count; i++) {
+        const preset_entry &e = idx->entries[ids[i]];
+        char name[96], category[64];
+        json_escape(name, sizeof(name), e.name.c_str());
+        json_escape(category, sizeof(category), e.category.c_str());
+        int n = snprintf(buf + offset, buf_len - offset,
+                         "%s{\"index\":%d,\"name\":\"%s\",\"category\":\"%s\"}",
+                         i ? "," : "", ids[i], name, category);
+        if (n >= buf_len - offset - 1) break;
+        offset += n;
+    }
+    offset += snprintf(buf + offset, buf_len - offset, "]");
+    return offset;
+}
+
+/* =====================================================================
+ * Preset loading
+ * ===================================================================== */
+
+static void mt_load_patch(surge_instance_t *inst, const preset_entry &entry);
+static std::mutex* patch_lock_of(surge_instance_t *inst);
+static void engine_hold(surge_instance_t *inst);
+static void engine_release(surge_instance_t *inst);
+
+static void load_preset_by_display_index(surge_instance_t *inst, int display_idx) {
+    if (!inst->synth) return;
+
+    auto &storage = inst->synth->storage;
+    preset_index *idx = acquire_presets(inst);
+    if (!idx || display_idx < 0 || display_idx >= (int)idx->entries.size()) {
+        release_presets(inst);
+        return;
+    }
+    const preset_entry &entry = idx->entries[display_idx];
+
+    /* Not while the saver is reading the patch, nor while any thread is
+     * inside process() */
+    std::unique_lock<std::mutex> saving;
+    if (std::mutex *m = patch_lock_of(inst)) saving = std::unique_lock<std::mutex>(*m);
+    if (inst->saver) inst->saver->loads++;
+    engine_hold(inst);
+
+    inst->eco_count = 0;
+    if (inst->mt) {
+        mt_load_patch(inst, entry);
+    } else if (entry.raw_idx >= 0) {
+        inst->synth->loadPatch(entry.raw_idx);
+    } else {
+        /* User patch that appeared after the instance scanned its patch list */
+        inst->synth->loadPatchByPath(entry.path.c_str(), -1, entry.name.c_str());
+    }
+    inst->current_preset = display_idx;
+    inst->current_preset_gen = idx->generation;
+    strncpy(inst->current_preset_path, entry.path.c_str(), sizeof(inst->current_preset_path) - 1);
+    inst->current_preset_path[sizeof(inst->current_preset_path) - 1] = '\0';
+    release_presets(inst);
+
+    auto &patch = storage.getPatch();
+    const char *name = patch.name.c_str();
+    if (name && name[0]) {
+        strncpy(inst->preset_name, name, sizeof(inst->preset_name) - 1);
+        inst->preset_name[sizeof(inst->preset_name) - 1] = '\0';
+    } else {
+        snprintf(inst->preset_name, sizeof(inst->preset_name), "Init");
+    }
+    if (saving) saving.unlock();
+
+    /* Re-populate parameter registry (param IDs may shift after patch load) */
+    populate_param_registry(inst);
+
+    if (inst->eco_mode) eco_apply(inst);
+    engine_release(inst);
+}
+
+/* =====================================================================
+ * User patch watcher
+ *
+ * An inotify thread follows the user patch directory tree. When .fxp files
+ * are written, moved or deleted it derives a new preset index from the
+ * published one (no rescan of the disk or of Surge's patch list) and swaps
+ * it in atomically. Surge's own patch_list stays as loaded at creation;
+ * entries added here load by path.
+ * ===================================================================== */
+
+static bool is_patch_file(const std::string &path) {
+    return path.size() > 4 && strcasecmp(path.c_str() + path.size() - 4, ".fxp") == 0;
+}
+
+static void watcher_add_dir(preset_watcher *w, const std::string &dir) {
+    int wd = inotify_add_watch(w->fd, dir.c_str(),
+        IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE | IN_CREATE | IN_DELETE_SELF);
+    if (wd < 0) return;
+    w->dirs.push_back(std::make_pair(wd, dir));
+
+    std::error_code ec;
+    for (auto &de : std::filesystem::directory_iterator(dir, ec)) {
+        if (de.is_directory(ec)) watcher_add_dir(w, de.path().string());
+    }
+}
+
+static const std::string* watcher_dir_for(preset_watcher *w, int wd) {
+    for (auto &d : w->dirs) {
+        if (d.first == wd) return &d.second;
+    }
+    return nullptr;
+}
+
+/* A folder was deleted or moved away: stop watching it and its subfolders.
+ * Deleted folders are unwatched by the kernel too; the IN_IGNORED that
+ * follows then finds nothing left to prune. */
+static void watcher_remove_dir(preset_watcher *w, const std::string &dir) {
+    std::string prefix = dir + "/";
+    for (size_t i = 0; i < w->dirs.size(); ) {
+        const std::string &d = w->dirs[i].second;
+        if (d == dir || d.compare(0, prefix.size(), prefix) == 0) {
+            inotify_rm_watch(w->fd, w->dirs[i].first);
+            w->dirs.erase(w->dirs.begin() + i);
+        } else {
+            i++;
+        }
+    }
+}
+
+static void watcher_forget_wd(preset_watcher *w, int wd) {
+    for (size_t i = 0; i < w->dirs.size(); i++) {
+        if (w->dirs[i].first == wd) {
+            w->dirs.erase(w->dirs.begin() + i);
+            return;
+        }
+    }
+}
+
+static void index_add_user_patch(preset_index *idx, const std::string &root, const std::string &path) {
+    for (auto &e : idx->entries) {
+        if (e.path == path) return;   /* overwritten in place */
+    }
+
+    std::filesystem::path p(path);
+    preset_entry e;
+    e.name = p.stem().string();
+    e.path = path;
+    e.raw_idx = -1;
+    std::string parent = p.parent_path().string();
+    e.category = (parent == root) ? "User" : p.parent_path().filename().string();
+
+    /* Keep categories together: insert after the last entry of the same
+     * category, ordered by name within the user-added run */
+    int insert_at = (int)idx->entries.size();
+    for (int i = (int)idx->entries.size() - 1; i >= 0; i--) {
+        if (idx->entries[i].category == e.category) {
+            insert_at = i + 1;
+            while (insert_at > 0 && idx->entries[insert_at - 1].raw_idx < 0 &&
+                   idx->entries[insert_at - 1].category == e.category &&
+                   strcasecmp(idx->entries[insert_at - 1].name.c_str(), e.name.c_str()) > 0) {
+                insert_at--;
+            }
+            break;
+        }
+    }
+    idx->entries.insert(idx->entries.begin() + insert_at, e);
+}
+
+static void index_remove_patch(preset_index *idx, const std::string &path) {
+    for (size_t i = 0; i < idx->entries.size(); i++) {
+        if (idx->entries[i].path == path) {
+            idx->entries.erase(idx->entries.begin() + i);
+            return;
+        }
+    }
+}
+
+static void index_remove_dir(preset_index *idx, const std::string &dir) {
+    std::string prefix = dir + "/";
+    for (size_t i = 0; i < idx->entries.size(); ) {
+        if (idx->entries[i].path.compare(0, prefix.size(), prefix) == 0) {
+            idx->entries.erase(idx->entries.begin() + i);
+        } else {
+            i++;
+        }
+    }
+}
+
+static void watcher_free_retired(surge_instance_t *inst, preset_watcher *w) {
+    if (inst->preset_readers.load() != 0) return;
+    for (preset_index *old : w->retired) delete old;
+    w->retired.clear();
+}
+
+static void watcher_thread(surge_instance_t *inst, preset_watcher *w) {
+    alignas(struct inotify_event) char events[4096];
+
+    while (!w->stop.load()) {
+        watcher_free_retired(inst, w);
+
+        struct pollfd pfd = { w->fd, POLLIN, 0 };
+        if (poll(&pfd, 1, 250) <= 0) continue;
+
+        ssize_t len = read(w->fd, events, sizeof(events));
+        if (len <= 0) continue;
+
+        /* Apply the whole read to one copy of the index, then publish */
+        preset_index *next = nullptr;
+        for (char *ptr = events; ptr < events + len; ) {
+            struct inotify_event *ev = (struct inotify_event*)ptr;
+            ptr += sizeof(struct inotify_event) + ev->len;
+
+            /* Watch gone (folder deleted, or unwatched by us) */
+            if (ev->mask & (IN_IGNORED | IN_DELETE_SELF)) {
+                watcher_forget_wd(w, ev->wd);
+                continue;
+            }
+
+            const std::string *dir = watcher_dir_for(w, ev->wd);
+            if (!dir || ev->len == 0) continue;
+            std::string path = *dir + "/" + ev->name;
+
+            if (!(ev->mask & IN_ISDIR) && !is_patch_file(path)) continue;
+
+            if (!next) {
+                preset_index *cur = inst->presets.load();
+                next = new preset_index();
+                next->generation = cur->generation + 1;
+                next->entries = cur->entries;
+            }
+            if ((ev->mask & IN_ISDIR) && (ev->mask & (IN_DELETE | IN_MOVED_FROM))) {
+                /* Folder deleted or moved away: drop everything under it.
+                 * A move within the tree comes back as IN_MOVED_TO. */
+                watcher_remove_dir(w, path);
+                index_remove_dir(next, path);
+            } else if (ev->mask & IN_ISDIR) {
+                /* New folder: watch it, and pick up files that landed in it
+                 * before the watch existed */
+                watcher_add_dir(w, path);
+                std::error_code ec;
+                for (auto &de : std::filesystem::recursive_directory_iterator(path, ec)) {
+                    std::string file = de.path().string();
+                    if (is_patch_file(file)) index_add_user_patch(next, w->root, file);
+                }
+            } else if (ev->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+                index_add_user_patch(next, w->root, path);
+            } else if (ev->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                index_remove_patch(next, path);
+            }
+        }
+
+        if (next) {
+            build_preset_trie(next);
+            w->retired.push_back(inst->presets.exchange(next));
+
+            char msg[128];
+            snprintf(msg, sizeof(msg), "User patches changed: %d presets",
+                     (int)next->entries.size());
+            plugin_log(msg);
+        }
+    }
+}
+
+static void start_preset_watcher(surge_instance_t *inst) {
+    std::error_code ec;
+    std::string root = inst->synth->storage.userPatchesPath.string();
+    if (root.empty() || !std::filesystem::is_directory(root, ec)) return;
+
+    preset_watcher *w = new preset_watcher();
+    w->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (w->fd < 0) {
+        delete w;
+        return;
+    }
+    w->root = root;
+    watcher_add_dir(w, root);
+    w->thread = std::thread(watcher_thread, inst, w);
+    inst->watcher = w;
+}
+
+static void stop_preset_watcher(surge_instance_t *inst) {
+    preset_watcher *w = inst->watcher;
+    if (!w) return;
+    w->stop.store(true);
+    if (w->thread.joinable()) w->thread.join();
+    close(w->fd);
+    for (preset_index *old : w->retired) delete old;
+    delete w;
+    inst->watcher = nullptr;
+}
+
+/* =====================================================================
+ * Asynchronous patch saving
+ *
+ * save_patch only validates the name and wakes the saver thread. The
+ * saver serialises the patch with saveRaw under the patch lock, which
+ * control-thread patch loads also take, between two snapshots of every
+ * parameter value. The control and render threads can still move values
+ * (set_param, batches, MIDI CC), so if the snapshots differ the patch is
+ * serialised again, and after SAVE_ATTEMPTS the save fails rather than
+ * write a file mixing two states. A save whose patch was replaced by a
+ * load before it ran fails the same way. The file is written to a
+ * temporary, renamed into place and fsynced; only then does the next
+ * control call give the live patch its new name.
+ * ===================================================================== */
+
+#define FXP_HEADER_SIZE 60
+
+static void snapshot_patch_values(SurgePatch &patch, std::vector<pdata> &out) {
+    size_t n = std::min(out.size(), patch.param_ptr.size());
+    for (size_t i = 0; i < n; i++) {
+        out[i] = patch.param_ptr[i] ? patch.param_ptr[i]->val : pdata{};
+    }
+}
+
+static bool patch_matches_snapshot(SurgePatch &patch, const std::vector<pdata> &snap) {
+    size_t n = std::min(snap.size(), patch.param_ptr.size());
+    for (size_t i = 0; i < n; i++) {
+        if (patch.param_ptr[i] && memcmp(&patch.param_ptr[i]->val, &snap[i], sizeof(pdata)) != 0)
+            return false;
+    }
+    return true;
+}
+
+static void put_be32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+/* Same layout as SurgeSynthesizer::savePatchToPath: fxp program chunk
+ * header, then the raw patch chunk */
+static void build_fxp(std::vector<uint8_t> &out, const char *name, const void *chunk, unsigned int size) {
+    out.assign(FXP_HEADER_SIZE, 0);
+    uint8_t *h = out.data();
+    memcpy(h + 0, "CcnK", 4);         /* chunkMagic */
+    put_be32(h + 4, 0);               /* byteSize */
+    memcpy(h + 8, "FPCh", 4);         /* fxMagic: opaque chunk */
+    put_be32(h + 12, 1);              /* version */
+    memcpy(h + 16, "cjs3", 4);        /* fxID */
+    put_be32(h + 20, 1);              /* fxVersion */
+    put_be32(h + 24, 1);              /* numPrograms */
+    strncpy((char*)h + 28, name, 27); /* prgName[28] */
+    put_be32(h + 56, size);           /* chunkSize */
+    out.insert(out.end(), (const uint8_t*)chunk, (const uint8_t*)chunk + size);
+}
+
+/* Serialises saves against patch loads on the same engine; nullptr for a
+ * standalone instance that has never saved */
+static std::mutex* patch_lock_of(surge_instance_t *inst) {
+    if (inst->mt) return &inst->mt->patch_lock;
+    return inst->saver ? &inst->saver->patch_lock : nullptr;
+}
+
+enum { SERIALISE_OK, SERIALISE_MOVING, SERIALISE_RELOADED };
+
+/* Saver thread. saveRaw writes the name and category from the live patch
+ * into the XML, so they are swapped in for the call and restored before
+ * the patch lock is released; nothing else reads them without the lock. */
+static int serialise_patch(surge_instance_t *inst, patch_saver *sv, const std::string &name,
+                           const std::string &category, uint32_t loads, std::vector<uint8_t> &out) {
+    std::lock_guard<std::mutex> lock(*patch_lock_of(inst));
+    if (sv->loads != loads) return SERIALISE_RELOADED;
+
+    auto &patch = inst->synth->storage.getPatch();
+    std::string old_name = patch.name, old_category = patch.category;
+    patch.name = name;
+    if (!category.empty()) patch.category = category;
+
+    int result = SERIALISE_MOVING;
+    for (int attempt = 0; attempt < SAVE_ATTEMPTS; attempt++) {
+        snapshot_patch_values(patch, sv->snapshot);
+        void *data = nullptr;
+        unsigned int size = inst->synth->saveRaw(&data);
+        if (!data || !patch_matches_snapshot(patch, sv->snapshot)) continue;
+        build_fxp(out, name.c_str(), data, size);
+        result = SERIALISE_OK;
+        break;
+    }
+    patch.name = old_name;
+    patch.category = old_category;
+    return result;
+}
+
+static bool write_file_synced(const std::string &path, const std::vector<uint8_t> &bytes) {
+    std::string tmp = path + ".tmp";
+    int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return false;
+    size_t done = 0;
+    while (done < bytes.size()) {
+        ssize_t n = write(fd, bytes.data() + done, bytes.size() - done);
+        if (n <= 0) break;
+        done += (size_t)n;
+    }
+    bool ok = done == bytes.size() && fsync(fd) == 0;
+    ok = close(fd) == 0 && ok;
+    if (!ok || rename(tmp.c_str(), path.c_str()) != 0) {
+        unlink(tmp.c_str());
+        return false;
+    }
+
+    std::string dir = std::filesystem::path(path).parent_path().string();
+    int dfd = open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dfd < 0) return false;
+    ok = fsync(dfd) == 0;
+    close(dfd);
+    return ok;
+}
+
+static void saver_thread(surge_instance_t *inst, patch_saver *sv) {
+    for (;;) {
+        std::string path, name, category;
+        uint32_t loads;
+        {
+            std::unique_lock<std::mutex> lock(sv->mtx);
+            sv->cv.wait(lock, [sv] { return sv->stop || sv->requested; });
+            if (sv->stop) return;
+            path = sv->path;
+            name = sv->name;
+            category = sv->category;
+            loads = sv->request_loads;
+            sv->requested = false;
+            snprintf(sv->status, sizeof(sv->status), "saving");
+        }
+
+        int serialised = serialise_patch(inst, sv, name, category, loads, sv->bytes);
+        bool written = false;
+        if (serialised == SERIALISE_OK) {
+            std::error_code ec;
+            std::filesystem::create_directories(std::filesystem::path(path).parent_path(), ec);
+            written = write_file_synced(path, sv->bytes);
+        }
+
+        std::lock_guard<std::mutex> lock(sv->mtx);
+        sv->buffer_bytes = sv->snapshot.capacity() * sizeof(pdata) + sv->bytes.capacity();
+        if (sv->requested) continue;   /* superseded, status follows the new save */
+        if (serialised == SERIALISE_MOVING) {
+            snprintf(sv->status, sizeof(sv->status), "error:parameters kept changing, %s not saved",
+                     path.c_str());
+        } else if (serialised == SERIALISE_RELOADED) {
+            snprintf(sv->status, sizeof(sv->status), "error:another patch was loaded, %s not saved",
+                     path.c_str());
+        } else if (!written) {
+            snprintf(sv->status, sizeof(sv->status), "error:could not write %s", path.c_str());
         } else {
-            strncpy(entry->key, sname, sizeof(entry->key) - 1);
+            snprintf(sv->status, sizeof(sv->status), "ok:%s", path.c_str());
+            sv->saved = true;
+            sv->saved_name = name;
+            sv->saved_category = category;
+            sv->saved_loads = loads;
         }
-        entry->key[sizeof(entry->key) - 1] = '\0';
+    }
+}
 
-        /* Display name from full name */
-        const char *fname = p->get_full_name();
-        strncpy(entry->display_name, fname, sizeof(entry->display_name) - 1);
-        entry->display_name[sizeof(entry->display_name) - 1] = '\0';
+/* Before every control call: name the live patch after a finished save,
+ * unless another patch has been loaded since it was requested */
+static void apply_saved_patch_name(surge_instance_t *inst) {
+    patch_saver *sv = inst->saver;
+    if (!sv) return;
+    std::string name, category;
+    {
+        std::lock_guard<std::mutex> lock(sv->mtx);
+        if (!sv->saved) return;
+        sv->saved = false;
+        if (sv->saved_loads != sv->loads) return;
+        name.swap(sv->saved_name);
+        category.swap(sv->saved_category);
+    }
 
-        entry->surge_id = id;
-        entry->valtype = p->valtype;
+    std::lock_guard<std::mutex> lock(*patch_lock_of(inst));
+    auto &patch = inst->synth->storage.getPatch();
+    patch.name = name;
+    if (!category.empty()) patch.category = category;
+    snprintf(inst->preset_name, sizeof(inst->preset_name), "%s", name.c_str());
+}
 
-        inst->param_count++;
+/* val is "Name" or "Category/Name"; saved under the user patch folder */
+static void request_patch_save(surge_instance_t *inst, const char *val) {
+    char category[64] = "";
+    char name[64];
+    const char *slash = strchr(val, '/');
+    if (slash) {
+        int n = (int)(slash - val);
+        if (n >= (int)sizeof(category)) n = (int)sizeof(category) - 1;
+        memcpy(category, val, n);
+        category[n] = '\0';
+        val = slash + 1;
     }
+    snprintf(name, sizeof(name), "%s", val);
 
-    char msg[128];
-    snprintf(msg, sizeof(msg), "Registered %d Scene A parameters", inst->param_count);
-    plugin_log(msg);
+    if (!name[0] || name[0] == '.' || strchr(name, '/') || category[0] == '.') {
+        snprintf(inst->error_msg, sizeof(inst->error_msg), "Invalid patch name");
+        return;
+    }
+
+    patch_saver *sv = inst->saver;
+    if (!sv) {
+        sv = new patch_saver();
+        sv->snapshot.resize(inst->synth->storage.getPatch().param_ptr.size());
+        sv->thread = std::thread(saver_thread, inst, sv);
+        inst->saver = sv;
+    }
+
+    std::filesystem::path path = inst->synth->storage.userPatchesPath;
+    if (category[0]) path /= category;
+    path /= std::string(name) + ".fxp";
+
+    {
+        std::lock_guard<std::mutex> lock(sv->mtx);
+        sv->path = path.string();
+        sv->name = name;
+        sv->category = category;
+        sv->request_loads = sv->loads;   /* control thread is its only writer */
+        sv->requested = true;
+        snprintf(sv->status, sizeof(sv->status), "pending");
+    }
+    sv->cv.notify_one();
 }
 
-/* Find a parameter entry by key */
-static surge_param_entry* find_param(surge_instance_t *inst, const char *key) {
-    for (int i = 0; i < inst->param_count; i++) {
-        if (strcmp(inst->params[i].key, key) == 0) {
-            return &inst->params[i];
+static void stop_patch_saver(surge_instance_t *inst) {
+    patch_saver *sv = inst->saver;
+    if (!sv) return;
+    {
+        std::lock_guard<std::mutex> lock(sv->mtx);
+        sv->stop = true;
+    }
+    sv->cv.notify_one();
+    if (sv->thread.joinable()) sv->thread.join();
+    delete sv;
+    inst->saver = nullptr;
+}
+
+/* =====================================================================
+ * Voice stealing
+ *
+ * Surge steals by note order once polylimit is reached, regardless of how
+ * loud the victim still is. Before a note-on that would exceed the limit we
+ * fast-release the least audible voice of the scene instead, so Surge finds
+ * a free slot and never cuts a loud held note while a faded tail survives.
+ * Only scenes the note will start a voice in are considered, so split and
+ * dual patches never lose a voice to a note played in the other scene.
+ * The victim is found by a scan of the scene's voices before each such
+ * note-on, not by an O(1) allocator. Off by default ("quiet_steal").
+ * ===================================================================== */
+
+/* Bit per scene Surge starts a voice in for this note, following the
+ * scene mode dispatch in SurgeSynthesizer::playNote */
+static int note_scene_mask(surge_instance_t *inst, int channel, int key) {
+    auto &patch = inst->synth->storage.getPatch();
+    int split = patch.splitpoint.val.i;
+    switch (patch.scenemode.val.i) {
+        case sm_split:   return key < split ? 1 : 2;
+        case sm_dual:    return 3;
+        case sm_chsplit: return channel < split / 8 + 1 ? 1 : 2;
+        default:         return 1 << patch.scene_active.val.i;
+    }
+}
+
+static void steal_quietest_voice(surge_instance_t *inst, int channel, int key) {
+    auto &patch = inst->synth->storage.getPatch();
+    int polylimit = patch.polylimit.val.i;
+    int scenes = note_scene_mask(inst, channel, key);
+
+    for (int sc = 0; sc < n_scenes; sc++) {
+        if (!(scenes & (1 << sc))) continue;
+        if (patch.scene[sc].polymode.val.i != 0) continue; /* mono modes steal themselves */
+
+        SurgeVoice *victim = nullptr;
+        float victim_score = 0.0f;
+        int live = 0;
+
+        for (SurgeVoice *v : inst->synth->voices[sc]) {
+            if (v->state.uberrelease) continue;
+            live++;
+
+            /* Released voices always go before gated ones; within each group
+             * the lowest envelope level wins, ties go to the oldest voice. */
+            float score = v->ampEGSource.get_output(0) + (v->state.gate ? 2.0f : 0.0f);
+            if (!victim || score < victim_score ||
+                (score == victim_score && v->age > victim->age)) {
+                victim = v;
+                victim_score = score;
+            }
+        }
+
+        if (victim && live >= polylimit) {
+            victim->uber_release();
+            inst->voice_steals++;
         }
     }
-    return nullptr;
 }
 
 /* =====================================================================
- * Preset loading
+ * Release tail culling
+ *
+ * A released voice keeps rendering until its amp envelope reaches zero,
+ * long after it drops below what the int16 output can represent. After
+ * each Surge block we estimate every released voice's output level from
+ * the amp envelope, mixer levels and scene volume, and fast-release
+ * those below the threshold (half an LSB by default). The estimate
+ * ignores filter resonance, waveshaper drive, feedback and FM, all of
+ * which can make a tail louder than its envelope says, so culling is off
+ * unless "tail_cull" is set; tests/tail_cull_test compares renders with
+ * it off and on.
  * ===================================================================== */
 
-static void load_preset_by_display_index(surge_instance_t *inst, int display_idx) {
-    if (!inst->synth) return;
+#define TAIL_THRESHOLD_DB_DEFAULT -96.3f   /* 0.5 / 32768 */
 
-    auto &storage = inst->synth->storage;
-    if (display_idx < 0 || display_idx >= (int)storage.patchOrdering.size()) return;
+/* Surge's amplitude parameters and amp envelope map to gain as x^3 */
+static inline float amp_curve(float x) {
+    if (x < 0.0f) x = 0.0f;
+    return x * x * x;
+}
 
-    int raw_idx = storage.patchOrdering[display_idx];
-    inst->synth->loadPatch(raw_idx);
-    inst->current_preset = display_idx;
+static void set_tail_threshold_db(surge_instance_t *inst, float db) {
+    if (db < -140.0f) db = -140.0f;
+    if (db > -40.0f) db = -40.0f;
+    inst->tail_threshold_db = db;
+    inst->tail_threshold = powf(10.0f, db / 20.0f);
+}
 
-    auto &patch = storage.getPatch();
-    const char *name = patch.name.c_str();
-    if (name && name[0]) {
-        strncpy(inst->preset_name, name, sizeof(inst->preset_name) - 1);
-        inst->preset_name[sizeof(inst->preset_name) - 1] = '\0';
-    } else {
-        snprintf(inst->preset_name, sizeof(inst->preset_name), "Init");
-    }
+static surge_instance_t* scene_owner(surge_instance_t *inst, int scene);
 
-    /* Re-populate parameter registry (param IDs may shift after patch load) */
-    populate_param_registry(inst);
+/* Each scene is culled with the settings (and counted in the stats) of
+ * the instance playing it, whichever part happened to run the engine */
+static void cull_inaudible_tails(surge_instance_t *inst) {
+    auto &patch = inst->synth->storage.getPatch();
+    float samplerate = inst->synth->storage.samplerate;
+
+    for (int sc = 0; sc < n_scenes; sc++) {
+        auto &voices = inst->synth->voices[sc];
+        if (voices.empty()) continue;
+        surge_instance_t *owner = scene_owner(inst, sc);
+        if (!owner || !owner->tail_cull) continue;
+
+        auto &scene = patch.scene[sc];
+        float mix = amp_curve(scene.level_o1.val.f);
+        mix = fmaxf(mix, amp_curve(scene.level_o2.val.f));
+        mix = fmaxf(mix, amp_curve(scene.level_o3.val.f));
+        mix = fmaxf(mix, amp_curve(scene.level_noise.val.f));
+        mix = fmaxf(mix, amp_curve(scene.level_ring_12.val.f));
+        mix = fmaxf(mix, amp_curve(scene.level_ring_23.val.f));
+        float scene_gain = mix * powf(10.0f, scene.level_pfg.val.f / 20.0f) *
+                           amp_curve(scene.volume.val.f) * owner->output_gain;
+
+        /* Release time in seconds (Surge stores envelope times as log2 s) */
+        float release_s = powf(2.0f, scene.adsr[0].r.val.f);
+
+        for (SurgeVoice *v : voices) {
+            if (v->state.gate || v->state.uberrelease) continue;
+
+            float eg = v->ampEGSource.get_output(0);
+            if (amp_curve(eg) * scene_gain >= owner->tail_threshold) continue;
+
+            v->uber_release();
+            owner->tails_culled++;
+            /* Envelope falls from eg to 0 over at most eg * release time */
+            owner->tail_blocks_saved +=
+                (uint64_t)(eg * release_s * samplerate / (float)BLOCK_SIZE);
+        }
+    }
 }
 
 /* =====================================================================
  * JSON builders for ui_hierarchy and chain_params
  * ===================================================================== */
 
+/* Builders write into a generous scratch allocation; keep only what the
+ * finished string needs */
+static char* trim_json(surge_instance_t *inst, char *json, size_t allocated) {
+    size_t used = strlen(json) + 1;
+    char *trimmed = (char*)realloc(json, used);
+    if (!trimmed) return json;
+    inst->json_bytes -= allocated - used;
+    return trimmed;
+}
+
 static void build_ui_hierarchy(surge_instance_t *inst) {
     /* 16KB should be plenty for the hierarchy JSON */
     const int bufsize = 16384;
     inst->ui_hierarchy_json = (char*)malloc(bufsize);
     if (!inst->ui_hierarchy_json) return;
+    inst->json_bytes += bufsize;
 
     snprintf(inst->ui_hierarchy_json, bufsize,
         "{"
@@ -381,33 +1919,1244 @@ static void build_ui_hierarchy(surge_instance_t *inst) {
             "}"
         "}"
         "}");
+    inst->ui_hierarchy_json = trim_json(inst, inst->ui_hierarchy_json, bufsize);
+}
+
+/* Skip a JSON string starting at the opening quote; copies it to out */
+static const char* scan_json_string(const char *p, char *out, int out_len) {
+    int n = 0;
+    p++;
+    while (*p && *p != '"') {
+        if (*p == '\\' && p[1]) p++;
+        if (out && n < out_len - 1) out[n++] = *p;
+        p++;
+    }
+    if (out) out[n] = '\0';
+    return *p ? p + 1 : p;
+}
+
+/* Skip any JSON value (string, object, array or scalar) */
+static const char* skip_json_value(const char *p) {
+    if (*p == '"') return scan_json_string(p, nullptr, 0);
+    if (*p == '{' || *p == '[') {
+        int depth = 0;
+        while (*p) {
+            if (*p == '"') { p = scan_json_string(p, nullptr, 0); continue; }
+            if (*p == '{' || *p == '[') depth++;
+            if (*p == '}' || *p == ']') { depth--; if (depth == 0) return p + 1; }
+            p++;
+        }
+        return p;
+    }
+    while (*p && *p != ',' && *p != '}' && *p != ']') p++;
+    return p;
+}
+
+/* Append the string entries of a JSON array to a level (objects skipped) */
+static const char* collect_level_keys(surge_instance_t *inst, const char *p, ui_level *level,
+                                      int pool_size) {
+    if (*p != '[') return skip_json_value(p);
+    p++;
+    while (*p && *p != ']') {
+        if (*p == '"') {
+            char key[48];
+            p = scan_json_string(p, key, sizeof(key));
+            bool dup = false;
+            for (int k = 0; k < level->key_count; k++) {
+                if (strcmp(level_key(inst, level, k), key) == 0) { dup = true; break; }
+            }
+            int len = (int)strlen(key) + 1;
+            if (!dup && level->key_count < MAX_LEVEL_KEYS &&
+                inst->level_key_pool_len + len <= pool_size) {
+                memcpy(inst->level_key_pool + inst->level_key_pool_len, key, len);
+                level->key_offs[level->key_count++] = (uint16_t)inst->level_key_pool_len;
+                inst->level_key_pool_len += len;
+            }
+        } else if (*p == '{' || *p == '[') {
+            p = skip_json_value(p);
+        } else {
+            p++;
+        }
+    }
+    return *p ? p + 1 : p;
+}
+
+/* Parse the knobs and params key lists of every level in ui_hierarchy */
+static void build_ui_levels(surge_instance_t *inst) {
+    inst->ui_level_count = 0;
+    if (!inst->ui_hierarchy_json) return;
+
+    const char *p = strstr(inst->ui_hierarchy_json, "\"levels\":{");
+    if (!p) return;
+    p += strlen("\"levels\":{");
+
+    /* Keys are substrings of the hierarchy, so its length bounds the pool;
+     * trimmed to what was used once parsed */
+    int pool_size = (int)strlen(p) + 1;
+    if (pool_size > 65536) pool_size = 65536;   /* uint16_t offsets */
+    free(inst->level_key_pool);
+    inst->level_key_pool = (char*)malloc(pool_size);
+    inst->level_key_pool_len = 0;
+    if (!inst->level_key_pool) return;
+
+    while (*p == '"' && inst->ui_level_count < MAX_UI_LEVELS) {
+        ui_level *level = &inst->ui_levels[inst->ui_level_count];
+        p = scan_json_string(p, level->name, sizeof(level->name));
+        if (*p++ != ':' || *p != '{') break;
+        p++;
+        level->key_count = 0;
+
+        /* Walk the level object's fields */
+        while (*p == '"') {
+            char field[16];
+            p = scan_json_string(p, field, sizeof(field));
+            if (*p++ != ':') break;
+            if (strcmp(field, "knobs") == 0 || strcmp(field, "params") == 0) {
+                p = collect_level_keys(inst, p, level, pool_size);
+            } else {
+                p = skip_json_value(p);
+            }
+            if (*p == ',') p++;
+        }
+        if (*p == '}') p++;
+        if (*p == ',') p++;
+        inst->ui_level_count++;
+    }
+
+    char *trimmed = (char*)realloc(inst->level_key_pool,
+                                   inst->level_key_pool_len > 0 ? inst->level_key_pool_len : 1);
+    if (trimmed) inst->level_key_pool = trimmed;
+
+    resolve_level_slots(inst);
+}
+
+static void build_chain_params(surge_instance_t *inst) {
+    /* Build chain_params JSON from the parameter registry.
+     * Include preset/octave_transpose plus all registered Surge params. */
+    const int bufsize = 32768;
+    inst->chain_params_json = (char*)malloc(bufsize);
+    if (!inst->chain_params_json) return;
+    inst->json_bytes += bufsize;
+
+    int offset = 0;
+    offset += snprintf(inst->chain_params_json + offset, bufsize - offset,
+        "[{\"key\":\"preset\",\"name\":\"Preset\",\"type\":\"int\",\"min\":0,\"max\":9999}"
+        ",{\"key\":\"octave_transpose\",\"name\":\"Octave\",\"type\":\"int\",\"min\":-3,\"max\":3}"
+        ",{\"key\":\"mpe_enabled\",\"name\":\"MPE Enabled\",\"type\":\"int\",\"min\":0,\"max\":1}"
+        ",{\"key\":\"mpe_pitch_bend_range\",\"name\":\"MPE PB Range\",\"type\":\"int\",\"min\":1,\"max\":96}");
+
+    for (int i = 0; i < inst->param_count && offset < bufsize - 200; i++) {
+        const char *type_str = (inst->params[i].valtype == 2) ? "float" :
+                               (inst->params[i].valtype == 1) ? "int" : "int";
+        offset += snprintf(inst->chain_params_json + offset, bufsize - offset,
+            ",{\"key\":\"%s\",\"name\":\"%s\",\"type\":\"%s\",\"min\":0,\"max\":1}",
+            inst->params[i].key,
+            inst->params[i].display_name,
+            type_str);
+    }
+
+    offset += snprintf(inst->chain_params_json + offset, bufsize - offset, "]");
+    inst->chain_params_json = trim_json(inst, inst->chain_params_json, bufsize);
+}
+
+/* =====================================================================
+ * Batched parameter changes
+ *
+ * set_param("params") takes either "key=value;key=value" or a flat JSON
+ * object {"key":value,...}, parsed in a single pass. Registered Surge
+ * params are queued and applied together by the render thread at the next
+ * Surge block boundary, so a knob page or morph step lands atomically.
+ * A module-level key splits the batch: the Surge params before it are
+ * handed over, then the key is set exactly as a separate set_param would
+ * (which first flushes them), and the params after it start a new batch.
+ * Any other set also flushes a batch still waiting for the render thread,
+ * so changes always reach Surge in the order they were made. A call with
+ * more than MAX_BATCH_PARAMS keys is rejected whole rather than applied
+ * in parts. Scheduled and render-ahead instances send the batch through
+ * their stamped param queue instead (see Render scheduler).
+ * ===================================================================== */
+
+static void set_param_impl(void *instance, const char *key, const char *val);
+static bool queue_params(surge_instance_t *inst, const batch_param *items, int count);
+
+/* Claim the batch buffer for writing. Only ever waits on the render
+ * thread while it applies a batch, which is a handful of setParameter01s. */
+static void batch_begin(surge_instance_t *inst) {
+    for (;;) {
+        int state = inst->batch_state.load(std::memory_order_acquire);
+        if (state == BATCH_APPLYING) { std::this_thread::yield(); continue; }
+        if (state == BATCH_EMPTY) {
+            int expected = BATCH_EMPTY;
+            if (inst->batch_state.compare_exchange_weak(expected, BATCH_WRITING,
+                    std::memory_order_acquire)) {
+                inst->batch_count = 0;
+                return;
+            }
+        } else if (state == BATCH_READY) {
+            /* Previous batch not applied yet - append to it */
+            int expected = BATCH_READY;
+            if (inst->batch_state.compare_exchange_weak(expected, BATCH_WRITING,
+                    std::memory_order_acquire)) {
+                return;
+            }
+        }
+    }
+}
+
+static void batch_end(surge_instance_t *inst) {
+    /* Scheduled and render-ahead instances apply it with their MIDI */
+    if (inst->param_queue && inst->batch_count > 0) {
+        queue_params(inst, inst->batch, inst->batch_count);
+        inst->batch_count = 0;
+    }
+    inst->batch_state.store(inst->batch_count > 0 ? BATCH_READY : BATCH_EMPTY,
+                            std::memory_order_release);
+}
+
+/* Apply and drop the queued items; caller owns the buffer (WRITING or
+ * APPLYING) */
+static void batch_apply_items(surge_instance_t *inst) {
+    for (int i = 0; i < inst->batch_count; i++) {
+        inst->synth->setParameter01(inst->batch[i].surge_id, inst->batch[i].value);
+    }
+    inst->batch_count = 0;
+}
+
+/* Control thread: apply a batch the render thread has not reached yet */
+static void flush_pending_batch(surge_instance_t *inst) {
+    for (;;) {
+        int state = inst->batch_state.load(std::memory_order_acquire);
+        if (state == BATCH_APPLYING) { std::this_thread::yield(); continue; }
+        if (state != BATCH_READY) return;   /* empty, or we are writing it */
+        int expected = BATCH_READY;
+        if (inst->batch_state.compare_exchange_weak(expected, BATCH_APPLYING,
+                std::memory_order_acquire)) {
+            batch_apply_items(inst);
+            inst->batch_state.store(BATCH_EMPTY, std::memory_order_release);
+            inst->display_gen.fetch_add(1, std::memory_order_release);
+            return;
+        }
+    }
+}
+
+static void batch_add(surge_instance_t *inst, const char *key, const char *val) {
+    surge_param_entry *entry = find_param(inst, key);
+    if (!entry) {
+        if (strcmp(key, "params") == 0) return;
+        /* Split: this key lands after the params before it and before
+         * the ones after it, which may resolve against a new patch */
+        batch_end(inst);
+        set_param_impl(inst, key, val);
+        batch_begin(inst);
+        return;
+    }
+
+    float v = (float)atof(val);
+    if (v < 0.0f) v = 0.0f;
+    if (v > 1.0f) v = 1.0f;
+    v = eco_cap_value(inst, entry, v);
+
+    /* set_params_batch made room for the whole call */
+    if (inst->batch_count == MAX_BATCH_PARAMS) return;
+    batch_param *bp = &inst->batch[inst->batch_count++];
+    bp->surge_id = entry->surge_id;
+    bp->value = v;
+}
+
+/* Upper bound on the keys in a batch string: one separator per key */
+static int count_batch_keys(const char *val) {
+    const char *p = val;
+    while (*p == ' ') p++;
+    char sep = (*p == '{') ? ':' : '=';
+    int n = 0;
+    for (; *p; p++) {
+        if (*p == sep) n++;
+    }
+    return n;
+}
+
+static void set_params_batch(surge_instance_t *inst, const char *val) {
+    char key[48];
+    char value[32];
+
+    int keys = count_batch_keys(val);
+    if (keys > MAX_BATCH_PARAMS) {
+        snprintf(inst->error_msg, sizeof(inst->error_msg),
+                 "params: %d keys, at most %d per batch", keys, MAX_BATCH_PARAMS);
+        return;
+    }
+
+    batch_begin(inst);
+    /* Appending to a batch the render thread has not reached would
+     * overflow: apply that one first, as a separate set would */
+    if (inst->batch_count + keys > MAX_BATCH_PARAMS) {
+        batch_end(inst);
+        flush_pending_batch(inst);
+        batch_begin(inst);
+    }
+
+    const char *p = val;
+    while (*p == ' ') p++;
+    bool json = (*p == '{');
+    if (json) p++;
+
+    for (;;) {
+        while (*p == ' ' || *p == ',' || *p == ';' || *p == '\n') p++;
+        if (*p == '\0' || *p == '}') break;
+
+        /* Key: quoted in JSON, up to '=' otherwise */
+        int n = 0;
+        if (json) {
+            if (*p != '"') break;
+            p++;
+            while (*p && *p != '"') { if (n < (int)sizeof(key) - 1) key[n++] = *p; p++; }
+            if (*p == '"') p++;
+            while (*p == ' ' || *p == ':') p++;
+        } else {
+            while (*p && *p != '=' && *p != ';') { if (n < (int)sizeof(key) - 1) key[n++] = *p; p++; }
+            if (*p == '=') p++;
+        }
+        key[n] = '\0';
+
+        /* Value: number, optionally quoted */
+        n = 0;
+        if (*p == '"') p++;
+        while (*p && *p != '"' && *p != ',' && *p != ';' && *p != '}') {
+            if (n < (int)sizeof(value) - 1) value[n++] = *p;
+            p++;
+        }
+        if (*p == '"') p++;
+        value[n] = '\0';
+
+        if (key[0]) batch_add(inst, key, value);
+    }
+
+    batch_end(inst);
+}
+
+/* Render thread: apply a ready batch between Surge blocks */
+static void apply_pending_batch(surge_instance_t *inst) {
+    int expected = BATCH_READY;
+    if (!inst->batch_state.compare_exchange_strong(expected, BATCH_APPLYING,
+            std::memory_order_acquire)) {
+        return;   /* nothing queued, or the control thread is mid-write */
+    }
+    batch_apply_items(inst);
+    inst->batch_state.store(BATCH_EMPTY, std::memory_order_release);
+    inst->display_gen.fetch_add(1, std::memory_order_release);
+}
+
+/* =====================================================================
+ * Multitimbral mode
+ *
+ * Instances created with "mt_group": N in their defaults share one
+ * SurgeSynthesizer per group instead of each carrying its own storage,
+ * wavetables, FX buffers and voice pool. The first part plays scene A and
+ * the second scene B; the engine runs in channel split mode and each
+ * part's notes are sent on a channel that lands in its own scene. Parts
+ * get Surge's per-scene outputs, which are taken before the global FX.
+ *
+ * Loading a preset into a part takes that preset's scene A: the other
+ * part's scene is parked on Surge's clipboard, the patch is loaded, the
+ * parked scene is pasted into scene B and the loading part moves to A.
+ * ===================================================================== */
+
+static std::mutex g_mt_lock;      /* guards g_mt_engines and part slots */
+static std::vector<mt_engine*> g_mt_engines;
+
+/* Surge sends channels below splitpoint / 8 + 1 to scene A, so a split
+ * point of 64 keeps channel 0 on A and MT_CHANNEL_SCENE_B on B. Patch
+ * loads reset both params, so this runs after every load. */
+static void mt_configure_engine(SurgeSynthesizer *synth) {
+    auto &patch = synth->storage.getPatch();
+    SurgeSynthesizer::ID id;
+    if (synth->fromSynthSideId(patch.scenemode.id, id)) {
+        synth->setParameter01(id, patch.scenemode.value_to_normalized((float)sm_chsplit));
+    }
+    if (synth->fromSynthSideId(patch.splitpoint.id, id)) {
+        synth->setParameter01(id, patch.splitpoint.value_to_normalized(64.0f));
+    }
+    synth->mpeEnabled = false;            /* MPE spreads notes over all channels */
+    synth->activateExtraOutputs = true;   /* fill sceneout */
+}
+
+/* Instance playing a scene: inst itself unless it is a multitimbral part.
+ * Called with the engine's render_lock held. */
+static surge_instance_t* scene_owner(surge_instance_t *inst, int scene) {
+    mt_engine *e = inst->mt;
+    if (!e) return inst;
+    for (int part = 0; part < MT_MAX_PARTS; part++) {
+        if (e->parts[part] && e->part_scene[part] == scene) return (surge_instance_t*)e->parts[part];
+    }
+    return nullptr;
+}
+
+static int mt_channel(const surge_instance_t *inst) {
+    return part_scene(inst) ? MT_CHANNEL_SCENE_B : 0;
+}
+
+/* Attach to an existing engine of the group with a free part */
+static bool mt_join(surge_instance_t *inst, int group) {
+    std::lock_guard<std::mutex> lk(g_mt_lock);
+    for (mt_engine *e : g_mt_engines) {
+        if (e->group != group) continue;
+        for (int part = 0; part < MT_MAX_PARTS; part++) {
+            if (e->parts[part]) continue;
+
+            /* Take the scene no other part is playing */
+            int used = 0;
+            for (int i = 0; i < MT_MAX_PARTS; i++) {
+                if (e->parts[i]) used |= 1 << e->part_scene[i];
+            }
+            int scene = 0;
+            while (used & (1 << scene)) scene++;
+
+            std::lock_guard<std::mutex> rl(e->render_lock);
+            e->parts[part] = inst;
+            e->part_scene[part] = scene;
+            e->plugin_layer->owners[part] = inst;
+            inst->mt = e;
+            inst->mt_part = part;
+            inst->mt_consumed = e->produced;
+            inst->synth = e->synth;
+            inst->plugin_layer = e->plugin_layer;
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Publish a freshly created engine as the group's, with inst as part 0 */
+static void mt_create(surge_instance_t *inst, int group) {
+    mt_engine *e = new mt_engine();
+    e->group = group;
+    e->synth = inst->synth;
+    e->plugin_layer = inst->plugin_layer;
+    e->parts[0] = inst;
+    e->part_scene[0] = 0;
+    e->part_scene[1] = 1;
+    inst->mt = e;
+    inst->mt_part = 0;
+    inst->mt_consumed = 0;
+    mt_configure_engine(e->synth);
+
+    std::lock_guard<std::mutex> lk(g_mt_lock);
+    g_mt_engines.push_back(e);
+}
+
+/* Detach a part. Returns true when it was the last one and the caller
+ * owns the engine's synth and plugin layer. */
+static bool mt_leave(surge_instance_t *inst) {
+    mt_engine *e = inst->mt;
+    std::lock_guard<std::mutex> lk(g_mt_lock);
+    {
+        std::lock_guard<std::mutex> rl(e->render_lock);
+        e->parts[inst->mt_part] = nullptr;
+        e->plugin_layer->owners[inst->mt_part] = nullptr;
+    }
+    for (int part = 0; part < MT_MAX_PARTS; part++) {
+        if (e->parts[part]) return false;
+    }
+    g_mt_engines.erase(std::find(g_mt_engines.begin(), g_mt_engines.end(), e));
+    delete e;
+    return true;
+}
+
+/* Load a preset's scene A into this part, keeping the other part's scene */
+static void mt_load_patch(surge_instance_t *inst, const preset_entry &entry) {
+    mt_engine *e = inst->mt;
+    auto &storage = e->synth->storage;
+    std::lock_guard<std::mutex> lk(g_mt_lock);
+    surge_instance_t *other = (surge_instance_t*)e->parts[1 - inst->mt_part];
+
+    {
+        std::lock_guard<std::mutex> rl(e->render_lock);
+        if (other) {
+            /* Park the other scene with its own unison values, not eco's */
+            if (other->eco_mode) eco_restore(other);
+            storage.clipboard_copy(cp_scene, part_scene(other), -1);
+        }
+        if (entry.raw_idx >= 0) {
+            e->synth->loadPatch(entry.raw_idx);
+        } else {
+            e->synth->loadPatchByPath(entry.path.c_str(), -1, entry.name.c_str());
+        }
+        if (other) storage.clipboard_paste(cp_scene, 1, -1);
+        e->part_scene[inst->mt_part] = 0;
+        e->part_scene[1 - inst->mt_part] = 1;
+        mt_configure_engine(e->synth);
+    }
+
+    if (other) {
+        /* Its params now live in scene B */
+        populate_param_registry(other);
+        if (other->eco_mode) eco_apply(other);
+    }
+}
+
+/* Heap block behind each loaded effect object, for memory_stats. This is
+ * the object size only: delay lines, reverb buffers or anything else an
+ * effect allocates on its own are not seen, and which of them live inside
+ * the object has not been checked against real Surge. Read here because
+ * effects are swapped inside process() on this thread. */
+#define FX_SAMPLE_INTERVAL 64
+
+static void sample_fx_bytes(surge_instance_t *inst) {
+    if (inst->fx_tick++ % FX_SAMPLE_INTERVAL != 0) return;
+    std::atomic<uint32_t> *bytes = inst->mt ? inst->mt->fx_bytes : inst->fx_bytes;
+    for (int i = 0; i < n_fx_slots; i++) {
+        Effect *fx = inst->synth->fx[i].get();
+        bytes[i].store(fx ? (uint32_t)malloc_usable_size(fx) : 0, std::memory_order_relaxed);
+    }
+}
+
+/* One Surge block with the per-block culling around it */
+static void run_engine_block(surge_instance_t *inst) {
+    /* Scene overlap: how often both scenes have voice work in one block.
+     * Instrumentation only; process() still renders the scenes one after
+     * the other, and this bounds what splitting them across cores could
+     * overlap */
+    int busy = 0;
+    for (int sc = 0; sc < n_scenes; sc++) {
+        size_t voices = inst->synth->voices[sc].size();
+        if (!voices) continue;
+        surge_instance_t *owner = scene_owner(inst, sc);
+        if (owner) owner->voice_blocks += voices;   /* counted with tail_cull on or off */
+        inst->scene_blocks[sc]++;
+        busy++;
+    }
+    if (busy == n_scenes) inst->dual_scene_blocks++;
+
+    inst->synth->process();
+    cull_inaudible_tails(inst);
+    sample_fx_bytes(inst);
+}
+
+/* Stage this part's next block, running the engine if no other part has
+ * rendered that block yet */
+static void mt_pull_block(surge_instance_t *inst) {
+    mt_engine *e = inst->mt;
+
+    /* The lock is only held long by a patch load on the control thread;
+     * never wait for it on the audio thread, play a silent block instead */
+    std::unique_lock<std::mutex> rl(e->render_lock, std::try_to_lock);
+    if (!rl.owns_lock()) {
+        memset(inst->block_out, 0, sizeof(inst->block_out));
+        inst->mt_lock_misses++;
+        inst->block_len = BLOCK_SIZE;
+        inst->block_pos = 0;
+        return;
+    }
+
+    /* Within a host cycle the part rendered second trails by that cycle's
+     * blocks. Trailing by more means its track wasn't rendered for a
+     * while; skip ahead rather than play stale audio late forever. */
+    uint64_t max_lag = 2 * ((inst->host_frames_per_block + BLOCK_SIZE - 1) / BLOCK_SIZE) + 1;
+    if (max_lag > MT_RING_BLOCKS) max_lag = MT_RING_BLOCKS;
+    if (e->produced - inst->mt_consumed >= max_lag) {
+        inst->mt_blocks_skipped += e->produced - inst->mt_consumed;
+        inst->mt_consumed = e->produced;
+    }
+
+    if (inst->mt_consumed == e->produced) {
+        run_engine_block(inst);
+        /* sceneout rows are BLOCK_SIZE_OS long; only the first BLOCK_SIZE
+         * samples are this block's output */
+        float (*dst)[N_OUTPUTS][BLOCK_SIZE] = e->ring[e->produced % MT_RING_BLOCKS];
+        for (int sc = 0; sc < n_scenes; sc++) {
+            for (int ch = 0; ch < N_OUTPUTS; ch++) {
+                memcpy(dst[sc][ch], e->synth->sceneout[sc][ch], BLOCK_SIZE * sizeof(float));
+            }
+        }
+        e->produced++;
+    }
+
+    float (*src)[BLOCK_SIZE] = e->ring[inst->mt_consumed % MT_RING_BLOCKS][part_scene(inst)];
+    memcpy(inst->block_out[0], src[0], BLOCK_SIZE * sizeof(float));
+    memcpy(inst->block_out[1], src[1], BLOCK_SIZE * sizeof(float));
+    inst->mt_consumed++;
+    inst->block_len = BLOCK_SIZE;
+    inst->block_pos = 0;
+}
+
+/* =====================================================================
+ * Half-rate rendering
+ *
+ * Bass and pad patches carry little energy above a quarter of the host
+ * rate, so the engine can run at half rate and be upsampled 2x; the CPU
+ * saving has not been measured on the device. Even output samples are the (delayed) input samples; odd
+ * ones are interpolated by the halfband filter's only non-trivial phase.
+ * ===================================================================== */
+
+static float g_halfband[HALFBAND_TAPS];
+static bool g_halfband_ready = false;
+
+static void init_halfband(void) {
+    if (g_halfband_ready) return;
+    halfband_design(g_halfband);
+    g_halfband_ready = true;
+}
+
+/* Switch the engine rate. setSamplerate rebuilds Surge's rate-dependent
+ * tables and resets every effect, so it runs here on the control thread
+ * with the engine held, never in the render path. */
+static void set_half_rate(surge_instance_t *inst, int enable) {
+    if (inst->mt) return;   /* would change the rate under the other part */
+    init_halfband();
+    if (inst->half_rate == enable) return;
+
+    engine_hold(inst);
+    inst->synth->allNotesOff();
+    inst->synth->setSamplerate((float)inst->sample_rate / (enable ? 2.0f : 1.0f));
+    memset(inst->upsample_hist, 0, sizeof(inst->upsample_hist));
+    inst->half_rate = enable;
+    engine_release(inst);
+
+    char msg[128];
+    snprintf(msg, sizeof(msg), "Half-rate mode %s (engine at %d Hz)",
+             enable ? "on" : "off", enable ? inst->sample_rate / 2 : inst->sample_rate);
+    plugin_log(msg);
+}
+
+/* Output delay the wrapper adds on top of Surge, in host frames, for hosts
+ * that compensate track latency. Block staging adds none: a new Surge
+ * block is rendered only when the host needs its first frame. */
+static int get_latency_frames(const surge_instance_t *inst) {
+    int frames = 0;
+    /* Even outputs of upsample_2x are the input HALFBAND_TAPS + 1 engine
+     * samples late; each engine sample is two host frames */
+    if (inst->half_rate) frames += 2 * (HALFBAND_TAPS + 1);
+    /* Render-ahead plays each block one host cycle after rendering it */
+    if (inst->ahead) frames += inst->host_frames_per_block;
+    return frames;
+}
+
+/* =====================================================================
+ * Denormal protection
+ *
+ * Decaying filter, delay and reverb state ends up in subnormal floats,
+ * which take a slow microcode path on ARM cores unless FPCR.FZ is set.
+ * The host thread's FP mode isn't ours to keep, so render_block sets
+ * flush-to-zero (and default NaN) on entry and restores it on exit.
+ *
+ * Every DENORMAL_CHECK_INTERVAL blocks the staged output is scanned for
+ * subnormals. That only sees the output: subnormals inside Surge's
+ * filter, delay and reverb state are not counted, and with ftz on the
+ * output cannot hold any. The count is a lower bound with ftz off; the
+ * CPU comparison is tests/tail_bench timing ftz 0 against 1.
+ * ===================================================================== */
+
+#define DENORMAL_CHECK_INTERVAL 64
+
+static void sample_denormals(surge_instance_t *inst) {
+    if (++inst->denormal_tick % DENORMAL_CHECK_INTERVAL != 0) return;
+    inst->denormal_checks++;
+    for (int c = 0; c < 2; c++) {
+        inst->denormals_seen += count_subnormals(inst->block_out[c], inst->block_len);
+    }
+}
+
+/* =====================================================================
+ * Engine hold
+ *
+ * Reconfiguring Surge (sample rate switches, patch loads, state restores)
+ * must not overlap a block on whichever thread renders this instance: the
+ * host's, a scheduler worker or the render-ahead worker. The control
+ * thread raises engine_hold (a count, so holds can nest) and waits for
+ * engine_busy to clear, which takes at most the one Surge block already
+ * running; the render path raises engine_busy before looking at
+ * engine_hold, so with sequentially consistent atomics one of the two
+ * always sees the other. Blocks due while the engine is held play
+ * silence rather than wait on the audio thread.
+ * ===================================================================== */
+
+#define ENGINE_HOLD_POLL_US 50
+
+static void engine_hold(surge_instance_t *inst) {
+    inst->engine_hold.fetch_add(1);
+    while (inst->engine_busy.load()) {
+        std::this_thread::sleep_for(std::chrono::microseconds(ENGINE_HOLD_POLL_US));
+    }
+}
+
+static void engine_release(surge_instance_t *inst) {
+    inst->engine_hold.fetch_sub(1);
+}
+
+/* Render path: false if the control thread holds the engine */
+static bool engine_enter(surge_instance_t *inst) {
+    inst->engine_busy.store(1);
+    if (inst->engine_hold.load() == 0) return true;
+    inst->engine_busy.store(0);
+    return false;
+}
+
+static void engine_exit(surge_instance_t *inst) {
+    inst->engine_busy.store(0);
+}
+
+/* A patch loaded inside Surge (its patch queue, e.g. a state restore
+ * racing a block) changes every value and every display string */
+static void notice_patch_change(surge_instance_t *inst) {
+    if (inst->synth->patchid == inst->notify_patchid) return;
+    inst->notify_patchid = inst->synth->patchid;
+    inst->all_dirty.store(1, std::memory_order_release);
+    inst->display_gen.fetch_add(1, std::memory_order_release);
+}
+
+/* Run one Surge block and stage its output for render_block to drain */
+static void render_next_block(surge_instance_t *inst) {
+    notice_patch_change(inst);
+    apply_pending_batch(inst);
+    if (inst->mt) {
+        mt_pull_block(inst);
+        notice_patch_change(inst);
+        return;
+    }
+    if (!engine_enter(inst)) {
+        memset(inst->block_out, 0, sizeof(inst->block_out));
+        inst->held_blocks++;
+        inst->block_len = inst->half_rate ? BLOCK_SIZE * 2 : BLOCK_SIZE;
+        inst->block_pos = 0;
+        return;
+    }
+    run_engine_block(inst);
+    /* Surge loads queued patches inside process(); tell readers now
+     * rather than a block later */
+    notice_patch_change(inst);
+
+    if (inst->half_rate) {
+        upsample_2x(g_halfband, inst->upsample_hist[0], inst->synth->output[0],
+                    inst->block_out[0], BLOCK_SIZE);
+        upsample_2x(g_halfband, inst->upsample_hist[1], inst->synth->output[1],
+                    inst->block_out[1], BLOCK_SIZE);
+        inst->block_len = BLOCK_SIZE * 2;
+    } else {
+        memcpy(inst->block_out[0], inst->synth->output[0], BLOCK_SIZE * sizeof(float));
+        memcpy(inst->block_out[1], inst->synth->output[1], BLOCK_SIZE * sizeof(float));
+        inst->block_len = BLOCK_SIZE;
+    }
+    inst->block_pos = 0;
+    engine_exit(inst);
 }
 
-static void build_chain_params(surge_instance_t *inst) {
-    /* Build chain_params JSON from the parameter registry.
-     * Include preset/octave_transpose plus all registered Surge params. */
-    const int bufsize = 32768;
-    inst->chain_params_json = (char*)malloc(bufsize);
-    if (!inst->chain_params_json) return;
+/* =====================================================================
+ * Render scheduler
+ *
+ * The host calls render_block for each track in turn on one thread, so
+ * heavy Surge tracks stack up on one core. Instances created with
+ * "parallel_render": 1 register here. The first registered instance to
+ * render in a host cycle (one that already rendered in the current
+ * scheduler cycle) starts the next cycle: it queues a job for every other
+ * idle instance and renders its own on the calling thread, while pool
+ * workers claim the others. Later render_block calls collect their
+ * finished output, or claim and render their job themselves if no worker
+ * got to it yet.
+ *
+ * A job advances its instance by exactly one host block, so each track's
+ * audio stays continuous. MIDI for a registered instance is stamped with
+ * the scheduler cycle it arrived in, and a job applies only events from
+ * before its own cycle: events sent before the cycle's first render_block
+ * play in that block, later ones exactly one block later, whichever
+ * thread renders the job and whenever it starts.
+ *
+ * Workers are ordinary threads, so render_block waits for a running job
+ * for at most half a host block. If it overruns, the worker is told to
+ * stop before its next Surge block, and once it has, render_block renders
+ * the rest of the host block inline after what the worker produced; the
+ * track then renders inline for SCHED_BACKOFF_CYCLES cycles before going
+ * back to the pool. A job from a cycle in which the host never called
+ * the track's render_block is not played a cycle late: a queued one is
+ * withdrawn, a finished one is discarded, and the current cycle's block
+ * is rendered instead.
+ * ===================================================================== */
 
-    int offset = 0;
-    offset += snprintf(inst->chain_params_json + offset, bufsize - offset,
-        "[{\"key\":\"preset\",\"name\":\"Preset\",\"type\":\"int\",\"min\":0,\"max\":9999}"
-        ",{\"key\":\"octave_transpose\",\"name\":\"Octave\",\"type\":\"int\",\"min\":-3,\"max\":3}"
-        ",{\"key\":\"mpe_enabled\",\"name\":\"MPE Enabled\",\"type\":\"int\",\"min\":0,\"max\":1}"
-        ",{\"key\":\"mpe_pitch_bend_range\",\"name\":\"MPE PB Range\",\"type\":\"int\",\"min\":1,\"max\":96}");
+static render_scheduler g_sched;
 
-    for (int i = 0; i < inst->param_count && offset < bufsize - 200; i++) {
-        const char *type_str = (inst->params[i].valtype == 2) ? "float" :
-                               (inst->params[i].valtype == 1) ? "int" : "int";
-        offset += snprintf(inst->chain_params_json + offset, bufsize - offset,
-            ",{\"key\":\"%s\",\"name\":\"%s\",\"type\":\"%s\",\"min\":0,\"max\":1}",
-            inst->params[i].key,
-            inst->params[i].display_name,
-            type_str);
+static int render_frames(surge_instance_t *inst, int16_t *out, int frames,
+                         const std::atomic<int> *stop = nullptr);
+static void handle_midi(surge_instance_t *inst, const uint8_t *msg, int len);
+
+/* Stamp for MIDI and params queued now. Render-ahead counts its own host
+ * cycles; scheduled instances share the scheduler's. */
+static uint32_t queue_stamp(surge_instance_t *inst) {
+    if (inst->ahead) return inst->host_cycle.load(std::memory_order_relaxed);
+    return g_sched.cycle.load(std::memory_order_acquire);
+}
+
+static void queue_midi(surge_instance_t *inst, const uint8_t *msg, int len) {
+    uint32_t head = inst->midi_head.load(std::memory_order_relaxed);
+    uint32_t tail = inst->midi_tail.load(std::memory_order_acquire);
+    if (head - tail >= MIDI_QUEUE_SIZE) {
+        inst->midi_dropped++;
+        return;
     }
+    midi_event *ev = &inst->midi_queue[head & (MIDI_QUEUE_SIZE - 1)];
+    ev->len = (uint8_t)(len < 3 ? len : 3);
+    memcpy(ev->data, msg, ev->len);
+    ev->stamp = queue_stamp(inst);
+    inst->midi_head.store(head + 1, std::memory_order_release);
+}
 
-    offset += snprintf(inst->chain_params_json + offset, bufsize - offset, "]");
+/* Control thread: queue Surge param changes, all or none. They get the
+ * same stamp as MIDI arriving now. */
+static bool queue_params(surge_instance_t *inst, const batch_param *items, int count) {
+    uint32_t head = inst->param_head.load(std::memory_order_relaxed);
+    uint32_t tail = inst->param_tail.load(std::memory_order_acquire);
+    if (head - tail + (uint32_t)count > PARAM_QUEUE_SIZE) {
+        inst->params_rejected += (uint64_t)count;
+        return false;
+    }
+    uint32_t stamp = queue_stamp(inst);
+    for (int i = 0; i < count; i++) {
+        param_event *ev = &inst->param_queue[(head + (uint32_t)i) & (PARAM_QUEUE_SIZE - 1)];
+        ev->surge_id = items[i].surge_id;
+        ev->value = items[i].value;
+        ev->stamp = stamp;
+    }
+    inst->param_head.store(head + (uint32_t)count, std::memory_order_release);
+    return true;
+}
+
+/* Apply queued MIDI; with all == false only events stamped before the
+ * given cycle */
+static void drain_midi(surge_instance_t *inst, bool all, uint32_t before) {
+    uint32_t tail = inst->midi_tail.load(std::memory_order_relaxed);
+    uint32_t head = inst->midi_head.load(std::memory_order_acquire);
+    for (; tail != head; tail++) {
+        midi_event *ev = &inst->midi_queue[tail & (MIDI_QUEUE_SIZE - 1)];
+        if (!all && (int32_t)(ev->stamp - before) >= 0) break;
+        handle_midi(inst, ev->data, ev->len);
+    }
+    inst->midi_tail.store(tail, std::memory_order_release);
+}
+
+/* Apply queued params, then MIDI, with the same cut-off: a param set just
+ * before a note reaches Surge in the same block, ahead of it */
+static void drain_events(surge_instance_t *inst, bool all, uint32_t before) {
+    uint32_t tail = inst->param_tail.load(std::memory_order_relaxed);
+    uint32_t head = inst->param_head.load(std::memory_order_acquire);
+    bool applied = false;
+    for (; tail != head; tail++) {
+        param_event *ev = &inst->param_queue[tail & (PARAM_QUEUE_SIZE - 1)];
+        if (!all && (int32_t)(ev->stamp - before) >= 0) break;
+        inst->synth->setParameter01(ev->surge_id, ev->value);
+        applied = true;
+    }
+    inst->param_tail.store(tail, std::memory_order_release);
+    if (applied) inst->display_gen.fetch_add(1, std::memory_order_release);
+    drain_midi(inst, all, before);
+}
+
+static void run_job(surge_instance_t *inst, bool on_worker) {
+    drain_events(inst, false, inst->job_cycle);
+    inst->job_rendered = render_frames(inst, inst->job_out, inst->job_frames,
+                                       on_worker ? &inst->job_cancel : nullptr);
+    if (on_worker) inst->jobs_worker++;
+    else inst->jobs_self++;
+    /* Last touch: once DONE the owner may collect and destroy */
+    inst->job_state.store(JOB_DONE, std::memory_order_release);
+}
+
+/* Called with g_sched.mtx held */
+static surge_instance_t* claim_queued_job(void) {
+    for (int i = 0; i < MAX_SCHED_INSTANCES; i++) {
+        surge_instance_t *inst = (surge_instance_t*)g_sched.slots[i];
+        if (!inst) continue;
+        int expected = JOB_QUEUED;
+        if (inst->job_state.compare_exchange_strong(expected, JOB_RUNNING)) return inst;
+    }
+    return nullptr;
+}
+
+static void sched_worker(void) {
+    std::unique_lock<std::mutex> lk(g_sched.mtx);
+    while (!g_sched.stop) {
+        surge_instance_t *inst = claim_queued_job();
+        if (!inst) {
+            g_sched.cv.wait(lk);
+            continue;
+        }
+        /* Claimed under the lock, so unregister can't free it mid-job:
+         * it waits for JOB_RUNNING to end */
+        lk.unlock();
+        run_job(inst, true);
+        lk.lock();
+    }
+}
+
+static void sched_register(surge_instance_t *inst) {
+    std::lock_guard<std::mutex> lk(g_sched.mtx);
+    for (int i = 0; i < MAX_SCHED_INSTANCES; i++) {
+        if (g_sched.slots[i]) continue;
+        g_sched.slots[i] = inst;
+        inst->sched_slot = i;
+        /* Its first render_block starts a cycle, so MIDI sent before it
+         * plays in that block */
+        inst->sched_seen = g_sched.cycle.load(std::memory_order_relaxed);
+        if (g_sched.registered++ == 0) {
+            int n = (int)std::thread::hardware_concurrency() - 1;
+            if (n < 1) n = 1;
+            if (n > SCHED_MAX_WORKERS) n = SCHED_MAX_WORKERS;
+            g_sched.stop = false;
+            for (int w = 0; w < n; w++) g_sched.workers.emplace_back(sched_worker);
+        }
+        return;
+    }
+    plugin_log("parallel_render: scheduler full, rendering inline");
+}
+
+static void sched_unregister(surge_instance_t *inst) {
+    std::vector<std::thread> retired;
+    {
+        std::lock_guard<std::mutex> lk(g_sched.mtx);
+        g_sched.slots[inst->sched_slot] = nullptr;
+        inst->sched_slot = -1;
+        if (--g_sched.registered == 0) {
+            g_sched.stop = true;
+            retired.swap(g_sched.workers);
+        }
+    }
+    g_sched.cv.notify_all();
+    for (auto &t : retired) t.join();
+    while (inst->job_state.load(std::memory_order_acquire) == JOB_RUNNING) std::this_thread::yield();
+}
+
+/* Start the next scheduler cycle and queue a job for every other idle
+ * registered instance not backing off. Returns the new cycle. */
+static uint32_t sched_start_cycle(surge_instance_t *self) {
+    uint32_t cycle;
+    {
+        std::lock_guard<std::mutex> lk(g_sched.mtx);
+        cycle = g_sched.cycle.load(std::memory_order_relaxed) + 1;
+        g_sched.cycle.store(cycle, std::memory_order_release);
+        for (int i = 0; i < MAX_SCHED_INSTANCES; i++) {
+            surge_instance_t *inst = (surge_instance_t*)g_sched.slots[i];
+            if (!inst || inst == self || inst->host_frames_per_block > SCHED_MAX_FRAMES) continue;
+            if (inst->sched_backoff.load(std::memory_order_relaxed) > 0) continue;
+            if (inst->job_state.load(std::memory_order_acquire) != JOB_IDLE) continue;
+            inst->job_frames = inst->host_frames_per_block;
+            inst->job_cycle = cycle;
+            inst->job_state.store(JOB_QUEUED, std::memory_order_release);
+        }
+    }
+    g_sched.cv.notify_all();
+    return cycle;
+}
+
+/* Wait for a running job for at most half a host block; true once it is
+ * done */
+static bool sched_wait(surge_instance_t *inst, int frames) {
+    if (inst->job_state.load(std::memory_order_acquire) != JOB_RUNNING) return true;
+    uint64_t limit = now_ns() + (uint64_t)frames * 500000000ull / (uint64_t)inst->sample_rate;
+    while (inst->job_state.load(std::memory_order_acquire) == JOB_RUNNING) {
+        if (now_ns() > limit) return false;
+        std::this_thread::yield();
+    }
+    return true;
+}
+
+/* The job overran on its worker. Stop it at the next Surge block
+ * boundary (the worker owns the engine until then), render the remaining
+ * frames inline after its output, and keep off the pool for a while. */
+static void sched_overrun(surge_instance_t *inst) {
+    inst->job_timeouts++;
+    inst->job_cancel.store(1, std::memory_order_release);
+    while (inst->job_state.load(std::memory_order_acquire) == JOB_RUNNING) std::this_thread::yield();
+    inst->job_cancel.store(0, std::memory_order_relaxed);
+    int done = inst->job_rendered;
+    if (done < inst->job_frames) {
+        render_frames(inst, inst->job_out + done * 2, inst->job_frames - done);
+    }
+    inst->sched_backoff.store(SCHED_BACKOFF_CYCLES, std::memory_order_relaxed);
+}
+
+/* A job left from a cycle the host skipped this track in. Withdraw it if
+ * no worker has started it; otherwise stop it at its next Surge block and
+ * drop what it rendered, which would otherwise play one cycle late. */
+static void sched_drop_skipped(surge_instance_t *inst) {
+    int expected = JOB_QUEUED;
+    if (inst->job_state.compare_exchange_strong(expected, JOB_IDLE)) return;
+    inst->job_cancel.store(1, std::memory_order_release);
+    while (inst->job_state.load(std::memory_order_acquire) == JOB_RUNNING) std::this_thread::yield();
+    inst->job_cancel.store(0, std::memory_order_relaxed);
+    if (inst->job_state.load(std::memory_order_acquire) == JOB_DONE) {
+        inst->jobs_discarded++;
+        inst->job_state.store(JOB_IDLE, std::memory_order_release);
+    }
+}
+
+/* render_block for a registered instance. Returns false when the call
+ * can't be served from a job and must render inline. */
+static bool sched_render(surge_instance_t *inst, int16_t *out, int frames) {
+    uint32_t cycle = g_sched.cycle.load(std::memory_order_acquire);
+    if (inst->sched_seen == cycle) cycle = sched_start_cycle(inst);
+    inst->sched_seen = cycle;
+
+    if (inst->job_state.load(std::memory_order_acquire) != JOB_IDLE && inst->job_cycle != cycle) {
+        sched_drop_skipped(inst);
+    }
+
+    /* Own job when idle (cycle leader, backing off, or not queued this
+     * cycle); a queued one no worker got to yet is rendered here too
+     * rather than waited for */
+    bool own = false;
+    if (inst->job_state.load(std::memory_order_acquire) == JOB_IDLE) {
+        if (frames != inst->host_frames_per_block || frames > SCHED_MAX_FRAMES) {
+            drain_events(inst, true, 0);
+            return false;
+        }
+        inst->job_frames = frames;
+        inst->job_cycle = cycle;
+        int expected = JOB_IDLE;
+        own = inst->job_state.compare_exchange_strong(expected, JOB_RUNNING);
+    }
+    if (!own) {
+        int expected = JOB_QUEUED;
+        own = inst->job_state.compare_exchange_strong(expected, JOB_RUNNING);
+    }
+    if (own) {
+        int backoff = inst->sched_backoff.load(std::memory_order_relaxed);
+        if (backoff > 0) inst->sched_backoff.store(backoff - 1, std::memory_order_relaxed);
+        run_job(inst, false);
+    }
+
+    if (inst->job_state.load(std::memory_order_acquire) == JOB_RUNNING) {
+        inst->job_waits++;
+        if (!sched_wait(inst, frames)) sched_overrun(inst);
+    }
+
+    if (inst->job_state.load(std::memory_order_acquire) != JOB_DONE) return false;
+    if (inst->job_frames == frames) {
+        memcpy(out, inst->job_out, (size_t)frames * 2 * sizeof(int16_t));
+        inst->job_state.store(JOB_IDLE, std::memory_order_release);
+        return true;
+    }
+    /* Host changed its block size; that block's audio is lost */
+    inst->job_state.store(JOB_IDLE, std::memory_order_release);
+    drain_events(inst, true, 0);
+    return false;
+}
+
+/* =====================================================================
+ * Render-ahead
+ *
+ * Instances created with "render_ahead": 1 trade one host block of
+ * latency for headroom: render_block returns the block a worker thread
+ * rendered during the previous host cycle and asks for the next one, so a
+ * process() spike only has to fit within a whole cycle, not the part of
+ * it left after the other tracks. MIDI and Surge param changes are
+ * stamped with the host cycle they arrived in and the worker applies only
+ * events from before the cycle it renders for, so every event lands
+ * exactly one block later however far the worker has got. If the worker
+ * is still busy when the host wants the block, render_block waits for at
+ * most half a block, then stops the worker before its next Surge block
+ * and renders the rest itself, as the scheduler does on an overrun.
+ * ===================================================================== */
+
+static void ahead_worker(surge_instance_t *inst, render_ahead *ra) {
+    std::unique_lock<std::mutex> lk(ra->mtx);
+    while (true) {
+        ra->cv.wait(lk, [ra] { return ra->stop || ra->pending; });
+        if (ra->stop) break;
+        ra->pending = false;
+        lk.unlock();
+
+        drain_events(inst, false, ra->cycle);
+        ra->rendered = render_frames(inst, ra->buf, ra->frames, &ra->cancel);
+        ra->busy.store(false, std::memory_order_release);
+
+        lk.lock();
+    }
+}
+
+static void start_render_ahead(surge_instance_t *inst) {
+    render_ahead *ra = new render_ahead();
+    inst->ahead = ra;
+    ra->thread = std::thread(ahead_worker, inst, ra);
+}
+
+static void stop_render_ahead(surge_instance_t *inst) {
+    render_ahead *ra = inst->ahead;
+    {
+        std::lock_guard<std::mutex> lk(ra->mtx);
+        ra->stop = true;
+    }
+    ra->cv.notify_one();
+    ra->thread.join();
+    inst->ahead = nullptr;
+    delete ra;
+}
+
+/* render_block in render-ahead mode. Returns false when the call must be
+ * rendered inline (host block size changed); the worker is idle then. */
+static bool ahead_render(surge_instance_t *inst, int16_t *out, int frames) {
+    render_ahead *ra = inst->ahead;
+    if (ra->busy.load(std::memory_order_acquire)) {
+        ra->late++;
+        uint64_t limit = now_ns() + (uint64_t)frames * 500000000ull / (uint64_t)inst->sample_rate;
+        while (ra->busy.load(std::memory_order_acquire) && now_ns() <= limit) std::this_thread::yield();
+        if (ra->busy.load(std::memory_order_acquire)) {
+            ra->overruns++;
+            ra->cancel.store(1, std::memory_order_release);
+            while (ra->busy.load(std::memory_order_acquire)) std::this_thread::yield();
+            ra->cancel.store(0, std::memory_order_relaxed);
+            if (ra->rendered < ra->frames) {
+                render_frames(inst, ra->buf + ra->rendered * 2, ra->frames - ra->rendered);
+            }
+        }
+    }
+
+    uint32_t cycle = inst->host_cycle.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (frames != inst->host_frames_per_block || frames > SCHED_MAX_FRAMES) {
+        drain_events(inst, true, 0);
+        ra->primed = false;
+        return false;
+    }
+
+    /* First block after start: the one-block latency is silence */
+    if (ra->primed) memcpy(out, ra->buf, (size_t)frames * 2 * sizeof(int16_t));
+    else memset(out, 0, (size_t)frames * 2 * sizeof(int16_t));
+
+    ra->frames = frames;
+    ra->cycle = cycle;
+    ra->primed = true;
+    ra->busy.store(true, std::memory_order_release);
+    {
+        std::lock_guard<std::mutex> lk(ra->mtx);
+        ra->pending = true;
+    }
+    ra->cv.notify_one();
+    return true;
+}
+
+/* =====================================================================
+ * Memory accounting (memory_stats)
+ *
+ * Sizes come from the objects themselves rather than /proc, so they can be
+ * attributed: the SurgeSynthesizer object (SurgeStorage's lookup tables
+ * are inside it and not broken out; the preallocated voice pool is
+ * reported inside it), the heap-allocated patch, the wavetables loaded
+ * into its oscillators, the loaded effect objects as last sampled by the
+ * render thread (object size only), and everything the wrapper
+ * allocates. The process RSS is reported alongside as the
+ * ground truth these should be checked against.
+ * ===================================================================== */
+
+/* Heap bytes behind a std::string (0 while it fits the inline buffer) */
+static size_t string_heap_bytes(const std::string &str) {
+    return str.capacity() > 15 ? str.capacity() + 1 : 0;
+}
+
+static size_t preset_index_bytes(const preset_index *idx) {
+    if (!idx) return 0;
+    size_t bytes = sizeof(preset_index);
+    bytes += idx->entries.capacity() * sizeof(preset_entry);
+    for (const preset_entry &e : idx->entries) {
+        bytes += string_heap_bytes(e.name) + string_heap_bytes(e.category) +
+                 string_heap_bytes(e.path);
+    }
+    bytes += idx->trie.capacity() * sizeof(preset_trie_node);
+    bytes += idx->trie_matches.capacity() * sizeof(preset_trie_match);
+    return bytes;
+}
+
+/* Float and int16 mipmapped copies of every oscillator's wavetable */
+static size_t wavetable_bytes(SurgePatch &patch) {
+    size_t bytes = 0;
+    for (int sc = 0; sc < n_scenes; sc++) {
+        for (int o = 0; o < n_oscs; o++) {
+            const Wavetable &wt = patch.scene[sc].osc[o].wt;
+            if (wt.TableF32Data) bytes += wt.dataSizes * sizeof(float);
+            if (wt.TableI16Data) bytes += wt.dataSizes * sizeof(short);
+        }
+    }
+    return bytes;
+}
+
+/* Resident set of the whole process in bytes, 0 without /proc. It spans
+ * every instance and whatever else the host loaded, so it can't be split
+ * by owner, but it is the number the device runs out of. */
+static size_t process_rss_bytes(void) {
+    FILE *f = fopen("/proc/self/statm", "r");
+    if (!f) return 0;
+    unsigned long pages = 0, resident = 0;
+    int n = fscanf(f, "%lu %lu", &pages, &resident);
+    fclose(f);
+    return n == 2 ? (size_t)resident * (size_t)sysconf(_SC_PAGESIZE) : 0;
+}
+
+static int format_memory_stats(surge_instance_t *inst, char *buf, int buf_len) {
+    size_t synth = sizeof(SurgeSynthesizer);
+    size_t voice_pool = sizeof(SurgeVoice) * MAX_VOICES * n_scenes;
+    size_t patch = sizeof(SurgePatch);
+    size_t wavetables = wavetable_bytes(inst->synth->storage.getPatch());
+
+    preset_index *idx = acquire_presets(inst);
+    size_t presets = preset_index_bytes(idx);
+    release_presets(inst);
+
+    size_t wrapper = sizeof(surge_instance_t) + inst->json_bytes + presets;
+    if (inst->watcher) wrapper += sizeof(preset_watcher);
+    if (inst->saver) {
+        std::lock_guard<std::mutex> lock(inst->saver->mtx);
+        wrapper += sizeof(patch_saver) + inst->saver->buffer_bytes;
+    }
+    if (inst->ahead) wrapper += sizeof(render_ahead);
+    if (inst->midi_queue) wrapper += MIDI_QUEUE_SIZE * sizeof(midi_event);
+    if (inst->param_queue) wrapper += PARAM_QUEUE_SIZE * sizeof(param_event);
+    if (inst->job_out) wrapper += SCHED_MAX_FRAMES * 2 * sizeof(int16_t);
+    wrapper += inst->level_key_pool_len;
+
+    /* A multitimbral part shares the engine; count it once per group */
+    int parts = 1;
+    if (inst->mt) {
+        parts = 0;
+        for (int i = 0; i < MT_MAX_PARTS; i++) parts += inst->mt->parts[i] != nullptr;
+    }
+    /* Effects, per slot (0 = empty) */
+    const std::atomic<uint32_t> *fx_bytes = inst->mt ? inst->mt->fx_bytes : inst->fx_bytes;
+    char slots[n_fx_slots * 12];
+    int slots_len = 0;
+    size_t fx = 0;
+    for (int i = 0; i < n_fx_slots; i++) {
+        uint32_t b = fx_bytes[i].load(std::memory_order_relaxed);
+        fx += b;
+        slots_len += snprintf(slots + slots_len, sizeof(slots) - slots_len, "%s%u", i ? "," : "", b);
+    }
+
+    size_t engine = synth + patch + wavetables + fx + (inst->mt ? sizeof(mt_engine) : 0);
+
+    /* voice_pool is part of synth, so it sits inside it */
+    return snprintf(buf, buf_len,
+        "{\"synth\":{\"bytes\":%zu,\"voice_pool\":%zu},\"patch\":%zu,\"wavetables\":%zu,"
+        "\"fx\":%zu,\"fx_slots\":[%s],"
+        "\"instance\":%zu,\"json\":%zu,\"preset_index\":%zu,\"wrapper\":%zu,"
+        "\"shared_parts\":%d,\"total\":%zu,\"process_rss\":%zu}",
+        synth, voice_pool, patch, wavetables, fx, slots,
+        sizeof(surge_instance_t), inst->json_bytes, presets, wrapper,
+        parts, engine / parts + wrapper, process_rss_bytes());
+}
+
+/* =====================================================================
+ * Deterministic rendering
+ *
+ * Surge's random sources (analog drift, unison and oscillator start
+ * phases, random LFOs and S&H) draw from std::rand and from the storage's
+ * own generator. A "seed" in the module defaults fixes both before the
+ * first patch loads, so tests can compare renders of such patches. The
+ * generator member has changed between Surge revisions, so it is only
+ * seeded where this revision has it.
+ * ===================================================================== */
+
+template <typename Storage>
+static void seed_storage_rng(Storage &storage, unsigned int seed) {
+    if constexpr (requires { storage.rngGen.g.seed(seed); }) storage.rngGen.g.seed(seed);
+}
+
+static void seed_engine_rng(surge_instance_t *inst, unsigned int seed) {
+    srand(seed);
+    seed_storage_rng(inst->synth->storage, seed);
 }
 
 /* =====================================================================
@@ -415,10 +3164,22 @@ static void build_chain_params(surge_instance_t *inst) {
  * ===================================================================== */
 
 static void* v2_create_instance(const char *module_dir, const char *json_defaults) {
-    (void)json_defaults;
-
     plugin_log("create_instance called");
 
+    float mt_group_val = 0.0f;
+    int mt_group = 0;
+    if (json_defaults && json_get_number(json_defaults, "mt_group", &mt_group_val) == 0) {
+        mt_group = (int)mt_group_val;
+    }
+    float parallel_val = 0.0f;
+    bool parallel_render = json_defaults &&
+        json_get_number(json_defaults, "parallel_render", &parallel_val) == 0 && parallel_val > 0.0f;
+    float ahead_val = 0.0f;
+    bool ahead = json_defaults &&
+        json_get_number(json_defaults, "render_ahead", &ahead_val) == 0 && ahead_val > 0.0f;
+    float seed_val = 0.0f;
+    bool seeded = json_defaults && json_get_number(json_defaults, "seed", &seed_val) == 0;
+
     surge_instance_t *inst = (surge_instance_t*)calloc(1, sizeof(surge_instance_t));
     if (!inst) return nullptr;
 
@@ -426,6 +3187,17 @@ static void* v2_create_instance(const char *module_dir, const char *json_default
     inst->output_gain = 0.5f;
     snprintf(inst->preset_name, sizeof(inst->preset_name), "Init");
     inst->error_msg[0] = '\0';
+    memset(inst->param_hash, 0xff, sizeof(inst->param_hash));
+    memset(inst->synth_to_slot, 0xff, sizeof(inst->synth_to_slot));
+    inst->quiet_steal = 0;    /* opt-in until tests/steal_bench and the golden renders back it */
+    inst->tail_cull = 0;      /* opt-in: the level estimate can undershoot, see cull_inaudible_tails */
+    inst->ftz = 1;
+    inst->sched_slot = -1;
+    inst->dirty_resume = -1;
+    inst->pending_program.store(-1, std::memory_order_relaxed);
+    inst->eco_unison_cap = ECO_UNISON_CAP_DEFAULT;
+    set_tail_threshold_db(inst, TAIL_THRESHOLD_DB_DEFAULT);
+    reset_render_stats(inst);
 
     char msg[256];
     snprintf(msg, sizeof(msg), "module_dir: %s", module_dir);
@@ -435,77 +3207,126 @@ static void* v2_create_instance(const char *module_dir, const char *json_default
      * Surge's sst-plugininfra uses HOME and XDG_DATA_HOME to find paths.
      * Without this, it tries to access /home/root/ which doesn't exist or
      * has wrong permissions on Move. We redirect both to ensure all path
-     * lookups (like ~/.Surge XT and ~/.local/share/...) go to writable dirs. */
+     * lookups (like ~/.Surge XT and ~/.local/share/...) go to writable dirs.
+     * SURGE_MOVE_CONFIG_DIR replaces the location for test runs off-device. */
+    const char *config_dir = getenv("SURGE_MOVE_CONFIG_DIR");
     char surge_home_path[512];
-    snprintf(surge_home_path, sizeof(surge_home_path),
+    snprintf(surge_home_path, sizeof(surge_home_path), "%s",
+             (config_dir && config_dir[0]) ? config_dir :
              "/data/UserData/move-anything/surge-config");
     setenv("HOME", surge_home_path, 1);
     setenv("XDG_DATA_HOME", surge_home_path, 1);
-    snprintf(msg, sizeof(msg), "Set HOME and XDG_DATA_HOME=%s", surge_home_path);
+    snprintf(msg, sizeof(msg), "Set HOME and XDG_DATA_HOME=%.200s", surge_home_path);
     plugin_log(msg);
 
-    /* Create plugin layer */
-    inst->plugin_layer = new MovePluginLayer();
+    /* Multitimbral parts of a group after the first share its engine */
+    bool joined = mt_group > 0 && mt_join(inst, mt_group);
 
-    /* Create SurgeSynthesizer */
-    char data_path[512];
-    snprintf(data_path, sizeof(data_path), "%s/surge-data", module_dir);
+    if (!joined) {
+        /* Create plugin layer */
+        inst->plugin_layer = new MovePluginLayer();
+        inst->plugin_layer->owners[0] = inst;
+
+        /* Create SurgeSynthesizer */
+        char data_path[512];
+        snprintf(data_path, sizeof(data_path), "%s/surge-data", module_dir);
 
-    try {
-        inst->synth = new SurgeSynthesizer(inst->plugin_layer, std::string(data_path));
-        plugin_log("SurgeSynthesizer created OK");
-    } catch (const std::exception &e) {
-        snprintf(msg, sizeof(msg), "Exception: %s, trying minimal mode", e.what());
-        plugin_log(msg);
-        try {
-            inst->synth = new SurgeSynthesizer(
-                inst->plugin_layer,
-                SurgeStorage::skipPatchLoadDataPathSentinel);
-        } catch (...) {
-            plugin_log("ERROR: All init attempts failed");
-            snprintf(inst->error_msg, sizeof(inst->error_msg),
-                     "Failed to initialize Surge engine");
-            delete inst->plugin_layer;
-            free(inst);
-            return nullptr;
-        }
-    } catch (...) {
-        plugin_log("Unknown exception, trying minimal mode");
         try {
-            inst->synth = new SurgeSynthesizer(
-                inst->plugin_layer,
-                SurgeStorage::skipPatchLoadDataPathSentinel);
+            inst->synth = new SurgeSynthesizer(inst->plugin_layer, std::string(data_path));
+            plugin_log("SurgeSynthesizer created OK");
+        } catch (const std::exception &e) {
+            snprintf(msg, sizeof(msg), "Exception: %s, trying minimal mode", e.what());
+            plugin_log(msg);
+            try {
+                inst->synth = new SurgeSynthesizer(
+                    inst->plugin_layer,
+                    SurgeStorage::skipPatchLoadDataPathSentinel);
+            } catch (...) {
+                plugin_log("ERROR: All init attempts failed");
+                snprintf(inst->error_msg, sizeof(inst->error_msg),
+                         "Failed to initialize Surge engine");
+                delete inst->plugin_layer;
+                free(inst);
+                return nullptr;
+            }
         } catch (...) {
-            plugin_log("ERROR: All init attempts failed");
-            delete inst->plugin_layer;
-            free(inst);
-            return nullptr;
+            plugin_log("Unknown exception, trying minimal mode");
+            try {
+                inst->synth = new SurgeSynthesizer(
+                    inst->plugin_layer,
+                    SurgeStorage::skipPatchLoadDataPathSentinel);
+            } catch (...) {
+                plugin_log("ERROR: All init attempts failed");
+                delete inst->plugin_layer;
+                free(inst);
+                return nullptr;
+            }
         }
     }
 
-    /* Configure for Move audio specs */
-    inst->synth->setSamplerate((float)MOVE_SAMPLE_RATE);
-    inst->synth->time_data.tempo = 120.0;
-    inst->synth->time_data.ppqPos = 0;
-    inst->synth->audio_processing_active = true;
+    /* Configure from the host's audio settings. setSamplerate rebuilds
+     * Surge's rate-dependent tables, so it must stay here on the control
+     * thread rather than anywhere near render_block. A joining
+     * multitimbral part uses the engine as its group configured it. */
+    inst->sample_rate = (g_host && g_host->sample_rate > 0) ?
+        g_host->sample_rate : MOVE_SAMPLE_RATE;
+    inst->host_frames_per_block = (g_host && g_host->frames_per_block > 0) ?
+        g_host->frames_per_block : MOVE_FRAMES_PER_BLOCK;
+    if (!joined) {
+        inst->synth->setSamplerate((float)inst->sample_rate);
+        inst->synth->time_data.tempo = 120.0;
+        inst->synth->time_data.ppqPos = 0;
+        inst->synth->audio_processing_active = true;
+        if (seeded) seed_engine_rng(inst, (unsigned int)seed_val);
+        if (mt_group > 0) mt_create(inst, mt_group);
+    }
 
     /* Build parameter registry */
     populate_param_registry(inst);
 
     /* Count available patches (using sorted ordering) */
-    inst->preset_count = (int)inst->synth->storage.patchOrdering.size();
-    if (inst->preset_count > 0) {
+    inst->presets.store(build_preset_index(inst->synth->storage));
+    start_preset_watcher(inst);
+    int preset_count = get_preset_count(inst);
+    if (preset_count > 0) {
         load_preset_by_display_index(inst, 0);
     }
 
     /* Build JSON strings */
     build_ui_hierarchy(inst);
+    build_ui_levels(inst);
     build_chain_params(inst);
 
-    snprintf(msg, sizeof(msg), "Instance created: %d patches, %d params",
-             inst->preset_count, inst->param_count);
+    snprintf(msg, sizeof(msg), "Instance created: %d patches, %d params, %d Hz, %d frames/block",
+             preset_count, inst->param_count,
+             inst->sample_rate, inst->host_frames_per_block);
     plugin_log(msg);
 
+    /* Last, once the instance is fully built: workers may render it from
+     * here on. Render-ahead already takes the instance off the host
+     * thread, so it wins over the scheduler. Multitimbral parts share one
+     * engine, so they can't render concurrently: on separate threads one
+     * would keep missing the render lock and play silence. */
+    if (inst->mt && (ahead || parallel_render)) {
+        plugin_log("mt_group: parallel_render and render_ahead ignored for a part");
+        ahead = parallel_render = false;
+    }
+    if (ahead || parallel_render) {
+        inst->midi_queue = (midi_event*)calloc(MIDI_QUEUE_SIZE, sizeof(midi_event));
+        inst->param_queue = (param_event*)calloc(PARAM_QUEUE_SIZE, sizeof(param_event));
+        if (parallel_render && !ahead) {
+            inst->job_out = (int16_t*)calloc(SCHED_MAX_FRAMES * 2, sizeof(int16_t));
+        }
+    }
+    bool queues = inst->midi_queue && inst->param_queue;
+    if (ahead && queues) start_render_ahead(inst);
+    else if (parallel_render && queues && inst->job_out) sched_register(inst);
+    if (!inst->ahead && inst->sched_slot < 0) {
+        /* Rendering inline after all: params apply directly */
+        free(inst->param_queue);
+        inst->param_queue = nullptr;
+    }
+
     return inst;
 }
 
@@ -513,10 +3334,21 @@ static void v2_destroy_instance(void *instance) {
     surge_instance_t *inst = (surge_instance_t*)instance;
     if (!inst) return;
 
+    if (inst->ahead) stop_render_ahead(inst);
+    if (inst->sched_slot >= 0) sched_unregister(inst);
+    free(inst->midi_queue);
+    free(inst->param_queue);
+    free(inst->job_out);
     free(inst->ui_hierarchy_json);
     free(inst->chain_params_json);
-    delete inst->synth;
-    delete inst->plugin_layer;
+    free(inst->level_key_pool);
+    stop_patch_saver(inst);
+    stop_preset_watcher(inst);
+    delete inst->presets.load();
+    if (!inst->mt || mt_leave(inst)) {
+        delete inst->synth;
+        delete inst->plugin_layer;
+    }
     free(inst);
     plugin_log("Instance destroyed");
 }
@@ -526,11 +3358,24 @@ static void v2_on_midi(void *instance, const uint8_t *msg, int len, int source)
     if (!inst || !inst->synth || len < 2) return;
     (void)source;
 
+    /* A scheduled or render-ahead instance may be rendering on a worker
+     * right now */
+    if (inst->sched_slot >= 0 || inst->ahead) {
+        queue_midi(inst, msg, len);
+        return;
+    }
+    handle_midi(inst, msg, len);
+}
+
+static void handle_midi(surge_instance_t *inst, const uint8_t *msg, int len) {
     uint8_t status = msg[0] & 0xF0;
     uint8_t channel = msg[0] & 0x0F;
     uint8_t data1 = msg[1];
     uint8_t data2 = (len > 2) ? msg[2] : 0;
 
+    /* A multitimbral part plays its scene through the channel split */
+    if (inst->mt) channel = (uint8_t)mt_channel(inst);
+
     int note = data1;
     if (status == 0x90 || status == 0x80) {
         note += inst->octave_transpose * 12;
@@ -541,6 +3386,7 @@ static void v2_on_midi(void *instance, const uint8_t *msg, int len, int source)
     switch (status) {
         case 0x90: /* Note On */
             if (data2 > 0) {
+                if (inst->quiet_steal) steal_quietest_voice(inst, channel, note);
                 inst->synth->playNote(channel, note, data2, 0);
             } else {
                 inst->synth->releaseNote(channel, note, 0);
@@ -550,6 +3396,7 @@ static void v2_on_midi(void *instance, const uint8_t *msg, int len, int source)
             inst->synth->releaseNote(channel, note, data2);
             break;
         case 0xB0: /* CC */
+            if (data1 == 0) inst->midi_bank = data2;
             inst->synth->channelController(channel, data1, data2);
             break;
         case 0xE0: { /* Pitch Bend */
@@ -564,22 +3411,31 @@ static void v2_on_midi(void *instance, const uint8_t *msg, int len, int source)
             inst->synth->polyAftertouch(channel, data1, data2);
             break;
         case 0xC0: /* Program Change */
-            inst->synth->programChange(channel, data1);
+            /* Loaded by the control thread through the wrapper's index, so
+             * "preset" and user patches agree with it. Would replace both
+             * parts' scenes; parts load via "preset". */
+            if (!inst->mt) {
+                inst->pending_program.store(inst->midi_bank * 128 + data1,
+                                            std::memory_order_release);
+            }
             break;
     }
 }
 
-static void v2_set_param(void *instance, const char *key, const char *val) {
+static void set_param_impl(void *instance, const char *key, const char *val) {
     surge_instance_t *inst = (surge_instance_t*)instance;
     if (!inst || !inst->synth) return;
 
-    /* State restore */
+    if (strcmp(key, "params") != 0) flush_pending_batch(inst);
+
+    /* State restore, between two blocks as a whole */
     if (strcmp(key, "state") == 0) {
         float fval;
+        engine_hold(inst);
         /* Restore preset first (sets all engine params to preset values) */
         if (json_get_number(val, "preset", &fval) == 0) {
             int idx = (int)fval;
-            if (idx >= 0 && idx < inst->preset_count) {
+            if (idx >= 0 && idx < get_preset_count(inst)) {
                 load_preset_by_display_index(inst, idx);
             }
         }
@@ -588,7 +3444,7 @@ static void v2_set_param(void *instance, const char *key, const char *val) {
             if (inst->octave_transpose < -3) inst->octave_transpose = -3;
             if (inst->octave_transpose > 3) inst->octave_transpose = 3;
         }
-        if (json_get_number(val, "mpe_enabled", &fval) == 0) {
+        if (json_get_number(val, "mpe_enabled", &fval) == 0 && !inst->mt) {
             inst->synth->mpeEnabled = ((int)fval > 0);
         }
         if (json_get_number(val, "mpe_pitch_bend_range", &fval) == 0) {
@@ -605,13 +3461,27 @@ static void v2_set_param(void *instance, const char *key, const char *val) {
                 inst->synth->setParameter01(inst->params[i].surge_id, fval);
             }
         }
+        if (inst->eco_mode) eco_apply(inst);
+        engine_release(inst);
+        return;
+    }
+
+    if (strcmp(key, "params") == 0) {
+        set_params_batch(inst, val);
+        return;
+    }
+    if (strcmp(key, "save_patch") == 0) {
+        request_patch_save(inst, val);
         return;
     }
 
     /* Module-level params */
     if (strcmp(key, "preset") == 0) {
         int idx = atoi(val);
-        if (idx >= 0 && idx < inst->preset_count && idx != inst->current_preset) {
+        preset_index *presets = acquire_presets(inst);
+        sync_current_preset(inst, presets);
+        release_presets(inst);
+        if (idx >= 0 && idx < get_preset_count(inst) && idx != inst->current_preset) {
             load_preset_by_display_index(inst, idx);
         }
         return;
@@ -626,7 +3496,67 @@ static void v2_set_param(void *instance, const char *key, const char *val) {
         inst->synth->allNotesOff();
         return;
     }
+    if (strcmp(key, "quiet_steal") == 0) {
+        inst->quiet_steal = atoi(val) > 0;
+        return;
+    }
+    if (strcmp(key, "half_rate") == 0) {
+        set_half_rate(inst, atoi(val) > 0);
+        return;
+    }
+    if (strcmp(key, "quality") == 0) {
+        int eco = (strcmp(val, "eco") == 0 || atoi(val) > 0);
+        if (eco && !inst->eco_mode) {
+            inst->eco_mode = 1;
+            eco_apply(inst);
+        } else if (!eco && inst->eco_mode) {
+            inst->eco_mode = 0;
+            eco_restore(inst);
+        }
+        return;
+    }
+    if (strcmp(key, "eco_unison_cap") == 0) {
+        int cap = atoi(val);
+        if (cap < 1) cap = 1;
+        if (cap > 16) cap = 16;
+        inst->eco_unison_cap = cap;
+        if (inst->eco_mode) {
+            /* Re-cap from the patch values */
+            eco_restore(inst);
+            eco_apply(inst);
+        }
+        return;
+    }
+    if (strcmp(key, "tail_cull") == 0) {
+        inst->tail_cull = atoi(val) > 0;
+        return;
+    }
+    if (strcmp(key, "soft_clip") == 0) {
+        inst->soft_clip = atoi(val) > 0;
+        return;
+    }
+    if (strcmp(key, "ftz") == 0) {
+        inst->ftz = atoi(val) > 0;
+        return;
+    }
+    if (strcmp(key, "tail_threshold_db") == 0) {
+        set_tail_threshold_db(inst, (float)atof(val));
+        return;
+    }
+    if (strcmp(key, "render_stats_reset") == 0) {
+        reset_render_stats(inst);
+        return;
+    }
+    if (strcmp(key, "control_stats_reset") == 0) {
+        memset(inst->ctl_stats, 0, sizeof(inst->ctl_stats));
+        return;
+    }
+    if (strcmp(key, "control_stats_enabled") == 0) {
+        inst->ctl_timing = atoi(val) > 0;
+        return;
+    }
     if (strcmp(key, "mpe_enabled") == 0) {
+        if (inst->mt) return;   /* channel split needs plain channels */
         bool enable = atoi(val) > 0;
         inst->synth->mpeEnabled = enable;
         char msg[128];
@@ -651,21 +3581,75 @@ static void v2_set_param(void *instance, const char *key, const char *val) {
         float v = (float)atof(val);
         if (v < 0.0f) v = 0.0f;
         if (v > 1.0f) v = 1.0f;
-        inst->synth->setParameter01(entry->surge_id, v);
+        batch_param item = { entry->surge_id, eco_cap_value(inst, entry, v) };
+        /* A worker may be rendering this instance: apply it in the
+         * render timeline, with the MIDI of the same cycle */
+        if (inst->param_queue) {
+            queue_params(inst, &item, 1);
+            return;
+        }
+        inst->synth->setParameter01(item.surge_id, item.value);
+        if (entry->valtype != 2) inst->display_gen.fetch_add(1, std::memory_order_release);
     }
 }
 
-static int v2_get_param(void *instance, const char *key, char *buf, int buf_len) {
+static int get_param_impl(void *instance, const char *key, char *buf, int buf_len);
+
+static int format_level_values(surge_instance_t *inst, const char *level_name,
+                               char *buf, int buf_len) {
+    const ui_level *level = nullptr;
+    for (int l = 0; l < inst->ui_level_count; l++) {
+        if (strcmp(inst->ui_levels[l].name, level_name) == 0) {
+            level = &inst->ui_levels[l];
+            break;
+        }
+    }
+    if (!level || !inst->synth) return -1;
+
+    int offset = snprintf(buf, buf_len, "{");
+    for (int k = 0; k < level->key_count; k++) {
+        char text[TXT_SIZE];
+        char escaped[96];
+        float v;
+
+        if (level->slots[k] >= 0) {
+            json_escape(escaped, sizeof(escaped), get_display_cached(inst, level->slots[k], &v));
+        } else {
+            /* Module-level key - its get_param value doubles as display */
+            if (get_param_impl(inst, level_key(inst, level, k), text, sizeof(text)) < 0) continue;
+            v = (float)atof(text);
+            json_escape(escaped, sizeof(escaped), text);
+        }
+
+        int n = snprintf(buf + offset, buf_len - offset, "%s\"%s\":{\"v\":%.6f,\"d\":\"%s\"}",
+                         offset > 1 ? "," : "", level_key(inst, level, k), v, escaped);
+        if (n >= buf_len - offset - 1) return -1;
+        offset += n;
+    }
+    offset += snprintf(buf + offset, buf_len - offset, "}");
+    return offset;
+}
+
+static int get_param_impl(void *instance, const char *key, char *buf, int buf_len) {
     surge_instance_t *inst = (surge_instance_t*)instance;
     if (!inst) return -1;
 
     /* Module-level params */
-    if (strcmp(key, "preset") == 0)
+    if (strcmp(key, "preset") == 0) {
+        preset_index *presets = acquire_presets(inst);
+        sync_current_preset(inst, presets);
+        release_presets(inst);
         return snprintf(buf, buf_len, "%d", inst->current_preset);
+    }
     if (strcmp(key, "preset_count") == 0)
-        return snprintf(buf, buf_len, "%d", inst->preset_count);
+        return snprintf(buf, buf_len, "%d", get_preset_count(inst));
     if (strcmp(key, "preset_name") == 0)
         return snprintf(buf, buf_len, "%s", inst->preset_name);
+    if (strcmp(key, "save_status") == 0) {
+        if (!inst->saver) return snprintf(buf, buf_len, "idle");
+        std::lock_guard<std::mutex> lock(inst->saver->mtx);
+        return snprintf(buf, buf_len, "%s", inst->saver->status);
+    }
     if (strcmp(key, "name") == 0)
         return snprintf(buf, buf_len, "Surge XT");
     if (strcmp(key, "octave_transpose") == 0)
@@ -674,9 +3658,79 @@ static int v2_get_param(void *instance, const char *key, char *buf, int buf_len)
         return snprintf(buf, buf_len, "%d", inst->synth ? (int)inst->synth->mpeEnabled : 0);
     if (strcmp(key, "mpe_pitch_bend_range") == 0)
         return snprintf(buf, buf_len, "%d", inst->synth ? (int)inst->synth->storage.mpePitchBendRange : 48);
+    if (strcmp(key, "quiet_steal") == 0)
+        return snprintf(buf, buf_len, "%d", inst->quiet_steal);
+    if (strcmp(key, "sample_rate") == 0)
+        return snprintf(buf, buf_len, "%d", inst->sample_rate);
+    if (strcmp(key, "latency_frames") == 0)
+        return snprintf(buf, buf_len, "%d", get_latency_frames(inst));
+    if (strcmp(key, "half_rate") == 0)
+        return snprintf(buf, buf_len, "%d", inst->half_rate);
+    if (strcmp(key, "quality") == 0)
+        return snprintf(buf, buf_len, "%s", inst->eco_mode ? "eco" : "normal");
+    if (strcmp(key, "eco_unison_cap") == 0)
+        return snprintf(buf, buf_len, "%d", inst->eco_unison_cap);
+    if (strcmp(key, "tail_cull") == 0)
+        return snprintf(buf, buf_len, "%d", inst->tail_cull);
+    if (strcmp(key, "soft_clip") == 0)
+        return snprintf(buf, buf_len, "%d", inst->soft_clip);
+    if (strcmp(key, "ftz") == 0)
+        return snprintf(buf, buf_len, "%d", inst->ftz);
+    if (strcmp(key, "denormal_stats") == 0) {
+        return snprintf(buf, buf_len,
+            "{\"ftz\":%d,\"blocks_sampled\":%llu,\"subnormals\":%llu}",
+            inst->ftz, (unsigned long long)inst->denormal_checks,
+            (unsigned long long)inst->denormals_seen);
+    }
+    if (strcmp(key, "tail_threshold_db") == 0)
+        return snprintf(buf, buf_len, "%.1f", inst->tail_threshold_db);
+    if (strcmp(key, "voice_stats") == 0 && inst->synth) {
+        int active = 0;
+        for (int sc = 0; sc < n_scenes; sc++) active += (int)inst->synth->voices[sc].size();
+        return snprintf(buf, buf_len,
+            "{\"active\":%d,\"steals\":%llu,\"voice_blocks\":%llu,"
+            "\"tails_culled\":%llu,\"tail_blocks_saved\":%llu,"
+            "\"scene_a_blocks\":%llu,\"scene_b_blocks\":%llu,\"dual_scene_blocks\":%llu}",
+            active, (unsigned long long)inst->voice_steals,
+            (unsigned long long)inst->voice_blocks,
+            (unsigned long long)inst->tails_culled,
+            (unsigned long long)inst->tail_blocks_saved,
+            (unsigned long long)inst->scene_blocks[0],
+            (unsigned long long)inst->scene_blocks[1],
+            (unsigned long long)inst->dual_scene_blocks);
+    }
+    if (strcmp(key, "memory_stats") == 0 && inst->synth) {
+        return format_memory_stats(inst, buf, buf_len);
+    }
+    if (strcmp(key, "sched_stats") == 0) {
+        return snprintf(buf, buf_len,
+            "{\"enabled\":%d,\"jobs_self\":%llu,\"jobs_worker\":%llu,"
+            "\"waits\":%llu,\"timeouts\":%llu,\"discarded\":%llu,\"midi_dropped\":%llu,"
+            "\"params_rejected\":%llu,\"render_ahead\":%d,\"ahead_late\":%llu,\"ahead_overruns\":%llu}",
+            inst->sched_slot >= 0, (unsigned long long)inst->jobs_self,
+            (unsigned long long)inst->jobs_worker, (unsigned long long)inst->job_waits,
+            (unsigned long long)inst->job_timeouts, (unsigned long long)inst->jobs_discarded,
+            (unsigned long long)inst->midi_dropped, (unsigned long long)inst->params_rejected,
+            inst->ahead != nullptr,
+            (unsigned long long)(inst->ahead ? inst->ahead->late : 0),
+            (unsigned long long)(inst->ahead ? inst->ahead->overruns : 0));
+    }
+    if (strcmp(key, "mt_status") == 0) {
+        if (!inst->mt) return snprintf(buf, buf_len, "{\"group\":0}");
+        return snprintf(buf, buf_len,
+            "{\"group\":%d,\"part\":%d,\"scene\":\"%c\",\"channel\":%d,"
+            "\"blocks_skipped\":%llu,\"lock_misses\":%llu}",
+            inst->mt->group, inst->mt_part, 'A' + part_scene(inst), mt_channel(inst),
+            (unsigned long long)inst->mt_blocks_skipped,
+            (unsigned long long)inst->mt_lock_misses);
+    }
 
     /* State serialization — includes all registered params for full save/restore */
     if (strcmp(key, "state") == 0) {
+        preset_index *presets = acquire_presets(inst);
+        sync_current_preset(inst, presets);
+        release_presets(inst);
+
         int offset = 0;
         offset += snprintf(buf + offset, buf_len - offset,
             "{\"preset\":%d,\"octave_transpose\":%d,\"mpe_enabled\":%d,\"mpe_pitch_bend_range\":%d",
@@ -685,7 +3739,7 @@ static int v2_get_param(void *instance, const char *key, char *buf, int buf_len)
             inst->synth ? (int)inst->synth->storage.mpePitchBendRange : 48);
 
         for (int i = 0; i < inst->param_count && offset < buf_len - 60; i++) {
-            float v = inst->synth->getParameter01(inst->params[i].surge_id);
+            float v = get_patch_value01(inst, &inst->params[i]);
             offset += snprintf(buf + offset, buf_len - offset,
                 ",\"%s\":%.6f", inst->params[i].key, v);
         }
@@ -694,6 +3748,71 @@ static int v2_get_param(void *instance, const char *key, char *buf, int buf_len)
         return offset;
     }
 
+    /* Render timing and output fingerprint, for regression harnesses.
+     * The hash covers every sample since creation or render_stats_reset. */
+    if (strcmp(key, "render_stats") == 0) {
+        double avg_us = inst->render_calls ?
+            (double)inst->render_ns_total / (double)inst->render_calls / 1000.0 : 0.0;
+        return snprintf(buf, buf_len,
+            "{\"calls\":%llu,\"frames\":%llu,\"avg_us\":%.2f,\"max_us\":%.2f,"
+            "\"held_blocks\":%llu,\"hash\":\"%08x\"}",
+            (unsigned long long)inst->render_calls,
+            (unsigned long long)inst->render_frames,
+            avg_us, (double)inst->render_ns_max / 1000.0,
+            (unsigned long long)inst->held_blocks, inst->output_hash);
+    }
+
+    if (strcmp(key, "control_stats") == 0)
+        return format_ctl_stats(inst, buf, buf_len);
+    if (strcmp(key, "control_stats_enabled") == 0)
+        return snprintf(buf, buf_len, "%d", inst->ctl_timing);
+
+    /* Registered params changed by MIDI, automation or patch loads since
+     * the previous poll - lets the UI skip polling every visible knob */
+    if (strcmp(key, "changed_params") == 0)
+        return format_changed_params(inst, buf, buf_len);
+
+    /* Paged preset names: preset_names:<offset>:<count> */
+    if (strncmp(key, "preset_names:", 13) == 0) {
+        int first = 0, count = 0;
+        if (sscanf(key + 13, "%d:%d", &first, &count) != 2) return -1;
+        preset_index *presets = acquire_presets(inst);
+        int total = presets ? (int)presets->entries.size() : 0;
+        if (first < 0) first = 0;
+        if (count > MAX_SEARCH_RESULTS) count = MAX_SEARCH_RESULTS;
+        if (count > total - first) count = total - first;
+        int ids[MAX_SEARCH_RESULTS];
+        for (int i = 0; i < count; i++) ids[i] = first + i;
+        int ret = presets ? format_preset_entries(presets, ids, count > 0 ? count : 0, buf, buf_len) : -1;
+        release_presets(inst);
+        return ret;
+    }
+    /* Prefix search over preset names: preset_search:<query> */
+    if (strncmp(key, "preset_search:", 14) == 0) {
+        int ids[MAX_SEARCH_RESULTS];
+        preset_index *presets = acquire_presets(inst);
+        int ret = -1;
+        if (presets) {
+            int count = search_preset_index(presets, key + 14, ids, MAX_SEARCH_RESULTS);
+            ret = format_preset_entries(presets, ids, count, buf, buf_len);
+        }
+        release_presets(inst);
+        return ret;
+    }
+
+    /* Human-readable value, e.g. "440.00 Hz" or an oscillator type name */
+    if (strncmp(key, "display:", 8) == 0) {
+        surge_param_entry *entry = find_param(inst, key + 8);
+        if (entry && inst->synth)
+            return snprintf(buf, buf_len, "%s",
+                            get_display_cached(inst, (int)(entry - inst->params), nullptr));
+        return get_param_impl(inst, key + 8, buf, buf_len);
+    }
+
+    /* All values of one hierarchy level: {"key":{"v":0.5,"d":"..."},...} */
+    if (strncmp(key, "level_values:", 13) == 0)
+        return format_level_values(inst, key + 13, buf, buf_len);
+
     /* Pre-built JSON responses */
     if (strcmp(key, "ui_hierarchy") == 0 && inst->ui_hierarchy_json) {
         int len = strlen(inst->ui_hierarchy_json);
@@ -716,39 +3835,108 @@ static int v2_get_param(void *instance, const char *key, char *buf, int buf_len)
     return -1;
 }
 
-static void v2_render_block(void *instance, int16_t *out_interleaved_lr, int frames) {
+/* Entry points. With control_stats_enabled each call is timed and
+ * classified so control_stats can report throughput and tail latency per
+ * kind of control traffic; otherwise they go straight through. */
+
+static int classify_ctl_key(const char *key, bool is_set) {
+    if (strcmp(key, "state") == 0) return is_set ? CTL_STATE_LOAD : CTL_STATE_SAVE;
+    if (strcmp(key, "ui_hierarchy") == 0 || strcmp(key, "chain_params") == 0) return CTL_JSON;
+    if (is_set && strcmp(key, "params") == 0) return CTL_BATCH;
+    if (strncmp(key, "control_stats", 13) == 0) return -1;
+    return is_set ? CTL_SET : CTL_GET;
+}
+
+static void v2_set_param(void *instance, const char *key, const char *val) {
     surge_instance_t *inst = (surge_instance_t*)instance;
-    if (!inst || !inst->synth) {
-        memset(out_interleaved_lr, 0, frames * 4);
+    if (!inst) return;
+    load_pending_program(inst);
+    apply_saved_patch_name(inst);
+    eco_follow_patch(inst);
+    if (!inst->ctl_timing) {
+        set_param_impl(instance, key, val);
         return;
     }
 
+    uint64_t t0 = now_ns();
+    set_param_impl(instance, key, val);
+    int kind = classify_ctl_key(key, true);
+    if (kind >= 0) record_ctl_stat(inst, kind, now_ns() - t0);
+}
+
+static int v2_get_param(void *instance, const char *key, char *buf, int buf_len) {
+    surge_instance_t *inst = (surge_instance_t*)instance;
+    if (!inst) return -1;
+    load_pending_program(inst);
+    apply_saved_patch_name(inst);
+    eco_follow_patch(inst);
+    if (!inst->ctl_timing) return get_param_impl(instance, key, buf, buf_len);
+
+    uint64_t t0 = now_ns();
+    int ret = get_param_impl(instance, key, buf, buf_len);
+    int kind = classify_ctl_key(key, false);
+    if (kind >= 0) record_ctl_stat(inst, kind, now_ns() - t0);
+    return ret;
+}
+
+/* Render frames into out; returns the frames rendered, fewer than asked
+ * only when stop was raised before a new Surge block was needed */
+static int render_frames(surge_instance_t *inst, int16_t *out_interleaved_lr, int frames,
+                         const std::atomic<int> *stop) {
+    uint64_t t0 = now_ns();
+    uint64_t fp_saved = 0;
+    bool ftz = inst->ftz;
+    if (ftz) fp_saved = fp_mode_enter_ftz();
     int out_idx = 0;
     int remaining = frames;
 
     while (remaining > 0) {
-        int chunk = (remaining > BLOCK_SIZE) ? BLOCK_SIZE : remaining;
+        if (inst->block_pos >= inst->block_len) {
+            if (stop && stop->load(std::memory_order_acquire)) break;
+            render_next_block(inst);
+            sample_denormals(inst);
+        }
 
-        inst->synth->process();
+        int chunk = inst->block_len - inst->block_pos;
+        if (chunk > remaining) chunk = remaining;
 
-        for (int i = 0; i < chunk; i++) {
-            float left = inst->synth->output[0][i] * inst->output_gain;
-            float right = inst->synth->output[1][i] * inst->output_gain;
+        convert_to_int16(inst->block_out[0] + inst->block_pos,
+                         inst->block_out[1] + inst->block_pos,
+                         inst->output_gain, inst->soft_clip,
+                         out_interleaved_lr + out_idx * 2, chunk);
+        out_idx += chunk;
 
-            int32_t l = (int32_t)(left * 32767.0f);
-            int32_t r = (int32_t)(right * 32767.0f);
-            if (l > 32767) l = 32767;
-            if (l < -32768) l = -32768;
-            if (r > 32767) r = 32767;
-            if (r < -32768) r = -32768;
+        inst->block_pos += chunk;
+        remaining -= chunk;
+    }
 
-            out_interleaved_lr[out_idx * 2] = (int16_t)l;
-            out_interleaved_lr[out_idx * 2 + 1] = (int16_t)r;
-            out_idx++;
-        }
+    /* Fingerprint the output exactly as the host sees it */
+    uint32_t h = inst->output_hash;
+    const uint8_t *bytes = (const uint8_t*)out_interleaved_lr;
+    for (int i = 0; i < out_idx * 4; i++) {
+        h = (h ^ bytes[i]) * FNV1A_PRIME;
+    }
+    inst->output_hash = h;
+    if (ftz) fp_mode_restore(fp_saved);
+
+    uint64_t dt = now_ns() - t0;
+    inst->render_calls++;
+    inst->render_frames += (uint64_t)out_idx;
+    inst->render_ns_total += dt;
+    if (dt > inst->render_ns_max) inst->render_ns_max = dt;
+    return out_idx;
+}
 
-        remaining -= chunk;
+static void v2_render_block(void *instance, int16_t *out_interleaved_lr, int frames) {
+    surge_instance_t *inst = (surge_instance_t*)instance;
+    if (!inst || !inst->synth) {
+        memset(out_interleaved_lr, 0, frames * 4);
+        return;
     }
+
+    if (inst->ahead && ahead_render(inst, out_interleaved_lr, frames)) return;
+    if (inst->sched_slot >= 0 && sched_render(inst, out_interleaved_lr, frames)) return;
+    render_frames(inst, out_interleaved_lr, frames);
 }
 
 static int v2_get_error(void *instance, char *buf, int buf_len) {
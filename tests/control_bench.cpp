@@ -0,0 +1,229 @@
+/*
+ * Control-path benchmark
+ *
+ * Times the set_param / get_param traffic a UI generates while a render
+ * thread plays held notes at the host's block rate, the way the control
+ * thread meets the audio thread on Move. set, get and display cycle
+ * through every registered param; ui_hierarchy and chain_params are
+ * retrieved whole; state is saved and restored whole. Each call is
+ * timed on its own and reported as mean, p50, p99 and max, with
+ * control_stats_enabled off, plus the mean with it on (the cost of the
+ * instrumentation) and the slowest render_block seen while the op ran.
+ * Then sets a knob page (8 params) and every registered param, one
+ * set_param per key against one "params" batch, in ns per key. Reports
+ * only; budgets for the control path live with the host.
+ *
+ *   control_bench <module_dir> [iterations]
+ */
+
+#include "harness.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#define BENCH_ITERATIONS 20000
+#define BENCH_PAUSE_EVERY 16      /* calls between short pauses, ~ a UI tick */
+#define BATCH_ROUNDS 200
+#define PAGE_KEYS 8
+#define MAX_BATCH_KEYS 512        /* plugin's MAX_BATCH_PARAMS */
+
+enum {
+    OP_SET,
+    OP_GET,
+    OP_DISPLAY,
+    OP_UI_HIERARCHY,
+    OP_CHAIN_PARAMS,
+    OP_STATE_SAVE,
+    OP_STATE_RESTORE,
+    OP_BATCH,
+    OP_COUNT
+};
+
+static const char *op_names[OP_COUNT] = {
+    "set", "get", "display", "ui_hierarchy", "chain_params",
+    "state_save", "state_restore", "batch"
+};
+
+/* Whole-document ops are ~100x the others; they get fewer calls */
+static const bool op_heavy[OP_COUNT] = {
+    false, false, false, true, true, true, true, false
+};
+
+static char g_buf[1 << 20];
+static std::string g_state;
+static std::vector<std::string> g_keys;
+static std::vector<std::string> g_display_keys;   /* "display:" + key */
+
+/* Render thread: one render_block per host block period, as on Move.
+ * render_max_ns is the slowest block since the control side last took it. */
+struct render_thread {
+    harness *h;
+    void *inst;
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> render_max_ns{0};
+};
+
+static void render_loop(render_thread *rt) {
+    int16_t out[HARNESS_FRAMES * 2];
+    auto period = std::chrono::nanoseconds(1000000000ll * HARNESS_FRAMES / HARNESS_SAMPLE_RATE);
+    auto next = std::chrono::steady_clock::now();
+    while (!rt->stop.load(std::memory_order_relaxed)) {
+        uint64_t t0 = harness_now_ns();
+        rt->h->api->render_block(rt->inst, out, HARNESS_FRAMES);
+        uint64_t dt = harness_now_ns() - t0;
+        uint64_t max = rt->render_max_ns.load(std::memory_order_relaxed);
+        while (dt > max && !rt->render_max_ns.compare_exchange_weak(max, dt)) {}
+        next += period;
+        std::this_thread::sleep_until(next);
+    }
+}
+
+static void run_op(harness *h, void *inst, int op, int i) {
+    char val[32];
+    const char *key = g_keys[i % g_keys.size()].c_str();
+    switch (op) {
+        case OP_SET:
+            snprintf(val, sizeof(val), "%.4f", (i % 100) / 100.0);
+            h->api->set_param(inst, key, val);
+            break;
+        case OP_GET:
+            h->api->get_param(inst, key, g_buf, sizeof(g_buf));
+            break;
+        case OP_DISPLAY:
+            h->api->get_param(inst, g_display_keys[i % g_keys.size()].c_str(), g_buf, sizeof(g_buf));
+            break;
+        case OP_UI_HIERARCHY:
+            h->api->get_param(inst, "ui_hierarchy", g_buf, sizeof(g_buf));
+            break;
+        case OP_CHAIN_PARAMS:
+            h->api->get_param(inst, "chain_params", g_buf, sizeof(g_buf));
+            break;
+        case OP_STATE_SAVE:
+            h->api->get_param(inst, "state", g_buf, sizeof(g_buf));
+            break;
+        case OP_STATE_RESTORE:
+            h->api->set_param(inst, "state", g_state.c_str());
+            break;
+        case OP_BATCH:
+            snprintf(g_buf, sizeof(g_buf), "filter1_cutoff=%.4f;osc1_pitch=%.4f",
+                     (i % 100) / 100.0, (i % 50) / 50.0);
+            h->api->set_param(inst, "params", g_buf);
+            break;
+    }
+}
+
+struct op_timing {
+    double mean, p50, p99, max;   /* ns per call */
+};
+
+/* Times each call on its own. A short pause every few calls lets the
+ * render thread apply what was sent, so caches see real value changes. */
+static op_timing time_op(harness *h, void *inst, int op, int iterations) {
+    std::vector<uint64_t> ns(iterations);
+    uint64_t total = 0;
+    for (int i = 0; i < iterations; i++) {
+        if (i % BENCH_PAUSE_EVERY == 0) std::this_thread::sleep_for(std::chrono::microseconds(200));
+        uint64_t t0 = harness_now_ns();
+        run_op(h, inst, op, i);
+        ns[i] = harness_now_ns() - t0;
+        total += ns[i];
+    }
+    std::sort(ns.begin(), ns.end());
+    op_timing t;
+    t.mean = (double)total / iterations;
+    t.p50 = (double)ns[(size_t)iterations / 2];
+    t.p99 = (double)ns[(size_t)iterations * 99 / 100];
+    t.max = (double)ns[iterations - 1];
+    return t;
+}
+
+/* ns per key for the first count keys: one set_param each, then the same
+ * values as one batch. Building the batch string is not timed. */
+static void compare_batch(harness *h, void *inst, int count) {
+    std::string batch;
+    uint64_t single = 0, batched = 0;
+    char val[32];
+    for (int r = 0; r < BATCH_ROUNDS; r++) {
+        std::this_thread::sleep_for(std::chrono::microseconds(500));
+        uint64_t t0 = harness_now_ns();
+        for (int i = 0; i < count; i++) {
+            snprintf(val, sizeof(val), "%.4f", ((r + i) % 100) / 100.0);
+            h->api->set_param(inst, g_keys[i].c_str(), val);
+        }
+        single += harness_now_ns() - t0;
+
+        std::this_thread::sleep_for(std::chrono::microseconds(500));
+        batch.clear();
+        for (int i = 0; i < count; i++) {
+            snprintf(val, sizeof(val), "=%.4f;", ((r + i + 1) % 100) / 100.0);
+            batch += g_keys[i];
+            batch += val;
+        }
+        t0 = harness_now_ns();
+        h->api->set_param(inst, "params", batch.c_str());
+        batched += harness_now_ns() - t0;
+    }
+    double per = (double)BATCH_ROUNDS * count;
+    printf("%-14d %14.0f %14.0f\n", count, single / per, batched / per);
+}
+
+int main(int argc, char **argv) {
+    harness h;
+    if (!harness_init(&h, argc, argv)) return 1;
+    int iterations = argc > 2 ? atoi(argv[2]) : BENCH_ITERATIONS;
+    if (iterations < 1) iterations = 1;
+
+    void *inst = harness_create(&h, "{}");
+    if (!inst) return 1;
+    g_keys = harness_param_keys(&h, inst);
+    if (g_keys.empty()) {
+        fprintf(stderr, "no registered params in chain_params\n");
+        return 1;
+    }
+    if (h.api->get_param(inst, "state", g_buf, sizeof(g_buf)) < 0) {
+        fprintf(stderr, "state save failed\n");
+        return 1;
+    }
+    g_state = g_buf;
+    for (const std::string &key : g_keys) g_display_keys.push_back("display:" + key);
+    printf("%zu registered params\n", g_keys.size());
+
+    static const int chord[] = { 48, 55, 60, 64 };
+    for (int note : chord) harness_note(&h, inst, note, 100);
+    render_thread rt;
+    rt.h = &h;
+    rt.inst = inst;
+    std::thread renderer(render_loop, &rt);
+
+    printf("%-14s %10s %10s %10s %10s %12s %12s\n", "call", "mean ns", "p50 ns", "p99 ns",
+           "max ns", "mean (timed)", "render max us");
+    for (int op = 0; op < OP_COUNT; op++) {
+        int n = op_heavy[op] ? iterations / 20 + 1 : iterations;
+        harness_set_int(&h, inst, "control_stats_enabled", 0);
+        rt.render_max_ns.store(0);
+        op_timing off = time_op(&h, inst, op, n);
+        double render_max_us = (double)rt.render_max_ns.load() / 1000.0;
+        harness_set_int(&h, inst, "control_stats_enabled", 1);
+        op_timing on = time_op(&h, inst, op, n);
+        printf("%-14s %10.0f %10.0f %10.0f %10.0f %12.0f %12.1f\n", op_names[op],
+               off.mean, off.p50, off.p99, off.max, on.mean, render_max_us);
+    }
+
+    h.api->get_param(inst, "control_stats", g_buf, sizeof(g_buf));
+    printf("control_stats: %s\n", g_buf);
+
+    harness_set_int(&h, inst, "control_stats_enabled", 0);
+    int all = (int)g_keys.size() < MAX_BATCH_KEYS ? (int)g_keys.size() : MAX_BATCH_KEYS;
+    printf("\n%-14s %14s %14s\n", "keys", "ns/key single", "ns/key batch");
+    if (all >= PAGE_KEYS) compare_batch(&h, inst, PAGE_KEYS);
+    if (all > PAGE_KEYS) compare_batch(&h, inst, all);
+
+    rt.stop = true;
+    renderer.join();
+    h.api->get_param(inst, "render_stats", g_buf, sizeof(g_buf));
+    printf("render_stats: %s\n", g_buf);
+    h.api->destroy_instance(inst);
+    return 0;
+}
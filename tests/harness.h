@@ -0,0 +1,135 @@
+/*
+ * Test harness for the Surge XT plugin
+ *
+ * Drives dsp.so through its v2 API the way the Move host does: one
+ * host_api, instances created from a module directory that holds
+ * surge-data, MIDI and params from the calling thread, render_block in
+ * host-sized blocks. Tests get the module directory as argv[1].
+ */
+
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <time.h>
+
+/* Mirror of the plugin API types declared in src/dsp/surge_plugin.cpp */
+extern "C" {
+typedef struct host_api_v1 {
+    uint32_t api_version;
+    int sample_rate;
+    int frames_per_block;
+    uint8_t *mapped_memory;
+    int audio_out_offset;
+    int audio_in_offset;
+    void (*log)(const char *msg);
+    int (*midi_send_internal)(const uint8_t *msg, int len);
+    int (*midi_send_external)(const uint8_t *msg, int len);
+} host_api_v1_t;
+
+typedef struct plugin_api_v2 {
+    uint32_t api_version;
+    void* (*create_instance)(const char *module_dir, const char *json_defaults);
+    void (*destroy_instance)(void *instance);
+    void (*on_midi)(void *instance, const uint8_t *msg, int len, int source);
+    void (*set_param)(void *instance, const char *key, const char *val);
+    int (*get_param)(void *instance, const char *key, char *buf, int buf_len);
+    int (*get_error)(void *instance, char *buf, int buf_len);
+    void (*render_block)(void *instance, int16_t *out_interleaved_lr, int frames);
+} plugin_api_v2_t;
+
+plugin_api_v2_t* move_plugin_init_v2(const host_api_v1_t *host);
+}
+
+#define HARNESS_SAMPLE_RATE 44100
+#define HARNESS_FRAMES 128
+#define HARNESS_SKIP 77           /* CTest SKIP_RETURN_CODE */
+
+struct harness {
+    host_api_v1_t host;
+    plugin_api_v2_t *api;
+    const char *module_dir;
+};
+
+static void harness_log(const char *msg) {
+    if (getenv("SURGE_MOVE_TEST_VERBOSE")) fprintf(stderr, "%s\n", msg);
+}
+
+static bool harness_init(harness *h, int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <module_dir> ...\n", argv[0]);
+        return false;
+    }
+    memset(&h->host, 0, sizeof(h->host));
+    h->host.api_version = 1;
+    h->host.sample_rate = HARNESS_SAMPLE_RATE;
+    h->host.frames_per_block = HARNESS_FRAMES;
+    h->host.log = harness_log;
+    h->module_dir = argv[1];
+    h->api = move_plugin_init_v2(&h->host);
+    return h->api != nullptr;
+}
+
+static void* harness_create(harness *h, const char *defaults) {
+    void *inst = h->api->create_instance(h->module_dir, defaults);
+    if (!inst) fprintf(stderr, "create_instance(%s) failed\n", defaults);
+    return inst;
+}
+
+static void harness_note(harness *h, void *inst, int note, int velocity) {
+    uint8_t msg[3] = { (uint8_t)(velocity ? 0x90 : 0x80), (uint8_t)note, (uint8_t)velocity };
+    h->api->on_midi(inst, msg, 3, 0);
+}
+
+static void harness_set_int(harness *h, void *inst, const char *key, int value) {
+    char val[16];
+    snprintf(val, sizeof(val), "%d", value);
+    h->api->set_param(inst, key, val);
+}
+
+static int harness_get_int(harness *h, void *inst, const char *key) {
+    char buf[64];
+    if (h->api->get_param(inst, key, buf, sizeof(buf)) < 0) return -1;
+    return atoi(buf);
+}
+
+/* Number after "key": in a flat JSON reply, or fallback when missing */
+static double json_number(const char *json, const char *key, double fallback) {
+    char search[64];
+    snprintf(search, sizeof(search), "\"%s\":", key);
+    const char *pos = strstr(json, search);
+    if (!pos) return fallback;
+    pos += strlen(search);
+    if (*pos == '"') pos++;
+    return strtod(pos, nullptr);
+}
+
+static uint64_t harness_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/* Keys of every registered Surge param, from chain_params (the module
+ * keys listed first there are left out) */
+static std::vector<std::string> harness_param_keys(harness *h, void *inst) {
+    static const char *module_keys[] = { "preset", "octave_transpose", "mpe_enabled", "mpe_pitch_bend_range" };
+    std::vector<std::string> keys;
+    std::vector<char> buf(1 << 20);
+    if (h->api->get_param(inst, "chain_params", buf.data(), (int)buf.size()) < 0) return keys;
+    for (const char *pos = strstr(buf.data(), "\"key\":\""); pos; pos = strstr(pos, "\"key\":\"")) {
+        pos += 7;
+        const char *end = strchr(pos, '"');
+        if (!end) break;
+        std::string key(pos, end - pos);
+        bool module = false;
+        for (const char *m : module_keys) module = module || key == m;
+        if (!module) keys.push_back(key);
+        pos = end;
+    }
+    return keys;
+}
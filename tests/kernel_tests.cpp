@@ -0,0 +1,223 @@
+/*
+ * Kernel tests
+ *
+ * Checks the wrapper's per-sample kernels in src/dsp/dsp_kernels.h on
+ * their own, without Surge: the scalar kernels against their reference
+ * behaviour everywhere, fast_tanh against its documented error bounds,
+ * the flush-to-zero switch on a decaying tail, and on aarch64 the NEON
+ * kernels against the scalar ones (bit-exact where the instructions
+ * allow, otherwise within a float rounding tolerance).
+ *
+ *   kernel_tests
+ */
+
+#include "dsp_kernels.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+#define TEST_BLOCK 32             /* Surge's block size on Move */
+#define TEST_BLOCKS 64
+#define UPSAMPLE_TOLERANCE 4e-6f  /* 16 fused vs unfused roundings at |x| < 2 */
+
+static int g_failures = 0;
+
+static void check(bool ok, const char *what) {
+    printf("%-52s %s\n", what, ok ? "ok" : "FAILED");
+    if (!ok) g_failures++;
+}
+
+static void test_upsample_dc(const float *coeffs) {
+    float hist[HALFBAND_HISTORY + TEST_BLOCK] = {};
+    float in[TEST_BLOCK], out[TEST_BLOCK * 2];
+    for (int i = 0; i < TEST_BLOCK; i++) in[i] = 1.0f;
+
+    /* Past the filter's latency, DC passes with unit gain on both phases */
+    float worst = 0.0f;
+    for (int b = 0; b < 4; b++) {
+        upsample_2x_scalar(coeffs, hist, in, out, TEST_BLOCK);
+        if (b < 2) continue;
+        for (int i = 0; i < TEST_BLOCK * 2; i++) worst = fmaxf(worst, fabsf(out[i] - 1.0f));
+    }
+    check(worst < 1e-5f, "upsample_2x: unit DC gain");
+}
+
+static void test_upsample_latency(const float *coeffs) {
+    float hist[HALFBAND_HISTORY + TEST_BLOCK] = {};
+    float in[TEST_BLOCK] = {}, out[TEST_BLOCK * 2];
+    in[0] = 1.0f;
+    upsample_2x_scalar(coeffs, hist, in, out, TEST_BLOCK);
+
+    /* The impulse comes out on the even phase HALFBAND_TAPS + 1 samples late */
+    int at = -1;
+    for (int i = 0; i < TEST_BLOCK; i++) {
+        if (out[2 * i] == 1.0f) at = i;
+    }
+    check(at == HALFBAND_TAPS + 1, "upsample_2x: latency is HALFBAND_TAPS + 1");
+}
+
+static void test_convert_scalar(void) {
+    const float l[6] = { 0.0f, 0.5f / 32767.0f, -0.5f / 32767.0f, 1.0f, 2.0f, -2.0f };
+    const float r[6] = { 0.5f, -0.5f, 1.0f / 32767.0f, -1.0f, 10.0f, -10.0f };
+    int16_t out[12];
+    convert_to_int16_scalar(l, r, 1.0f, false, out, 6);
+    const int16_t want[12] = { 0, 16383, 0, -16383, 0, 1, 32767, -32767, 32767, 32767, -32768, -32768 };
+    check(memcmp(out, want, sizeof(want)) == 0, "convert_to_int16: truncates and saturates");
+
+    /* Soft clip leaves the knee and below alone and stays within full scale */
+    float in[2] = { SOFT_CLIP_KNEE, 8.0f };
+    convert_to_int16_scalar(in, in, 1.0f, true, out, 2);
+    check(out[0] == (int16_t)(SOFT_CLIP_KNEE * 32767.0f) && out[2] > 32700,
+          "convert_to_int16: soft clip knee and ceiling");
+}
+
+/* Max abs error of f against tanh over [-range, range], every 1e-5 */
+template <typename F>
+static double tanh_error(F f, float range) {
+    double worst = 0.0;
+    long steps = (long)(range * 1e5f);
+    for (long i = -steps; i <= steps; i++) {
+        float x = (float)i * 1e-5f;
+        worst = fmax(worst, fabs((double)f(x) - tanh((double)x)));
+    }
+    return worst;
+}
+
+template <typename F>
+static void check_tanh_bounds(F f, const char *name) {
+    char what[96];
+    double e2 = tanh_error(f, 2.0f), e4 = tanh_error(f, 4.0f), eall = tanh_error(f, 8.0f);
+    snprintf(what, sizeof(what), "%s: |x| < 2 within %g (%.3g)", name, (double)FAST_TANH_ERR_2, e2);
+    check(e2 <= FAST_TANH_ERR_2, what);
+    snprintf(what, sizeof(what), "%s: |x| < 4 within %g (%.3g)", name, (double)FAST_TANH_ERR_4, e4);
+    check(e4 <= FAST_TANH_ERR_4, what);
+    snprintf(what, sizeof(what), "%s: all x within %g (%.3g)", name, (double)FAST_TANH_ERR_ALL, eall);
+    check(eall <= FAST_TANH_ERR_ALL, what);
+}
+
+static void test_soft_clip_shape(void) {
+    /* Monotonic (to within the rational's float rounding, one ulp near
+     * full scale and far below an int16 step), continuous at the knee and
+     * never past full scale */
+    bool monotonic = true, bounded = true;
+    float prev = 0.0f;
+    for (int i = 0; i <= 200000; i++) {
+        float y = soft_clip_sample(i * 1e-4f);
+        if (y < prev - 1.2e-7f) monotonic = false;
+        if (y > 1.0f) bounded = false;
+        prev = y;
+    }
+    float step = soft_clip_sample(SOFT_CLIP_KNEE + 1e-4f) - soft_clip_sample(SOFT_CLIP_KNEE);
+    check(monotonic && bounded, "soft_clip_sample: monotonic, at most full scale");
+    check(fabsf(step - 1e-4f) < 1e-5f, "soft_clip_sample: unit slope at the knee");
+    check(soft_clip_sample(-3.0f) == -soft_clip_sample(3.0f), "soft_clip_sample: odd symmetry");
+}
+
+/* A decaying one-pole tail, as a filter or reverb leaves behind after a
+ * note: subnormal without flush-to-zero, exactly zero with it */
+static int decay_subnormals(void) {
+    static volatile float seed = 1e-30f;   /* keeps the loop at run time */
+    float tail[256];
+    float y = seed;
+    for (int i = 0; i < 256; i++) {
+        y *= 0.5f;
+        tail[i] = y;
+    }
+    return count_subnormals(tail, 256);
+}
+
+static void test_fp_mode(void) {
+#if FP_MODE_FTZ_SUPPORTED
+    int before = decay_subnormals();
+    uint64_t saved = fp_mode_enter_ftz();
+    int during = decay_subnormals();
+    fp_mode_restore(saved);
+    int after = decay_subnormals();
+    uint64_t again = fp_mode_enter_ftz();
+    fp_mode_restore(again);
+
+    check(before > 0 && after == before, "fp_mode: tail goes subnormal without ftz");
+    check(during == 0, "fp_mode: no subnormals with ftz");
+    check(again == saved, "fp_mode: restore gives back the caller's mode");
+#else
+    printf("FTZ not supported on this target\n");
+#endif
+}
+
+#if DSP_KERNELS_HAVE_NEON
+static float fast_tanh_neon_lane(float x) {
+    return vgetq_lane_f32(fast_tanh_neon(vdupq_n_f32(x)), 0);
+}
+
+/* Deterministic noise in [-range, range] */
+static uint32_t g_rng = 12345;
+static float noise(float range) {
+    g_rng = g_rng * 1664525u + 1013904223u;
+    return ((g_rng >> 8) * (1.0f / 16777216.0f) * 2.0f - 1.0f) * range;
+}
+
+static void test_upsample_neon(const float *coeffs) {
+    float hist_s[HALFBAND_HISTORY + TEST_BLOCK] = {};
+    float hist_n[HALFBAND_HISTORY + TEST_BLOCK] = {};
+    float in[TEST_BLOCK], out_s[TEST_BLOCK * 2], out_n[TEST_BLOCK * 2];
+    float worst = 0.0f;
+    bool even_exact = true;
+    for (int b = 0; b < TEST_BLOCKS; b++) {
+        for (int i = 0; i < TEST_BLOCK; i++) in[i] = noise(1.0f);
+        upsample_2x_scalar(coeffs, hist_s, in, out_s, TEST_BLOCK);
+        upsample_2x_neon(coeffs, hist_n, in, out_n, TEST_BLOCK);
+        for (int i = 0; i < TEST_BLOCK; i++) {
+            if (out_s[2 * i] != out_n[2 * i]) even_exact = false;
+            worst = fmaxf(worst, fabsf(out_s[2 * i + 1] - out_n[2 * i + 1]));
+        }
+    }
+    check(even_exact, "upsample_2x NEON: even phase bit-exact");
+    char what[64];
+    snprintf(what, sizeof(what), "upsample_2x NEON: odd phase within %g (%g)",
+             (double)UPSAMPLE_TOLERANCE, (double)worst);
+    check(worst <= UPSAMPLE_TOLERANCE, what);
+}
+
+static void test_convert_neon(void) {
+    /* Odd frame count so the scalar tail runs too; range past full scale */
+    const int frames = TEST_BLOCK * 4 + 3;
+    float l[frames], r[frames];
+    int16_t out_s[frames * 2], out_n[frames * 2];
+    for (int i = 0; i < frames; i++) {
+        l[i] = noise(2.5f);
+        r[i] = noise(2.5f);
+    }
+
+    convert_to_int16_scalar(l, r, 0.7f, false, out_s, frames);
+    convert_to_int16_neon(l, r, 0.7f, false, out_n, frames);
+    check(memcmp(out_s, out_n, sizeof(out_s)) == 0, "convert_to_int16 NEON: bit-exact");
+
+    convert_to_int16_scalar(l, r, 0.7f, true, out_s, frames);
+    convert_to_int16_neon(l, r, 0.7f, true, out_n, frames);
+    int worst = 0;
+    for (int i = 0; i < frames * 2; i++) worst = std::max(worst, abs(out_s[i] - out_n[i]));
+    check(worst <= 1, "convert_to_int16 NEON: soft clip within 1 LSB");
+}
+#endif
+
+int main() {
+    float coeffs[HALFBAND_TAPS];
+    halfband_design(coeffs);
+
+    test_upsample_dc(coeffs);
+    test_upsample_latency(coeffs);
+    test_convert_scalar();
+    check_tanh_bounds(fast_tanh, "fast_tanh");
+    test_soft_clip_shape();
+    test_fp_mode();
+#if DSP_KERNELS_HAVE_NEON
+    check_tanh_bounds(fast_tanh_neon_lane, "fast_tanh NEON");
+    test_upsample_neon(coeffs);
+    test_convert_neon();
+#else
+    printf("NEON kernels not available on this target, compared on aarch64 only\n");
+#endif
+
+    return g_failures ? 1 : 0;
+}
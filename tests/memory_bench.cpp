@@ -0,0 +1,48 @@
+/*
+ * Memory benchmark
+ *
+ * Creates idle instances one at a time, up to four, rendering a few
+ * blocks on each so their buffers are touched. After each one it prints
+ * the process RSS and the summed memory_stats totals, so the real
+ * per-instance cost and the share memory_stats accounts for can be read
+ * off on the target. Reports only.
+ *
+ *   memory_bench <module_dir>
+ */
+
+#include "harness.h"
+
+#define MEMORY_INSTANCES 4
+#define WARM_BLOCKS 100
+
+static char g_buf[4096];
+
+int main(int argc, char **argv) {
+    harness h;
+    if (!harness_init(&h, argc, argv)) return 1;
+
+    void *insts[MEMORY_INSTANCES];
+    int16_t out[HARNESS_FRAMES * 2];
+    double first_rss = 0.0;
+    printf("%-10s %14s %14s %16s\n", "instances", "RSS KiB", "stats KiB", "KiB / instance");
+    for (int n = 0; n < MEMORY_INSTANCES; n++) {
+        insts[n] = harness_create(&h, "{}");
+        if (!insts[n]) return 1;
+        for (int b = 0; b < WARM_BLOCKS; b++) h.api->render_block(insts[n], out, HARNESS_FRAMES);
+
+        double stats = 0.0, rss = 0.0;
+        for (int i = 0; i <= n; i++) {
+            h.api->get_param(insts[i], "memory_stats", g_buf, sizeof(g_buf));
+            stats += json_number(g_buf, "total", 0.0) / 1024.0;
+            rss = json_number(g_buf, "process_rss", 0.0) / 1024.0;
+        }
+        if (n == 0) {
+            first_rss = rss;
+            printf("%-10d %14.0f %14.0f %16s\n", n + 1, rss, stats, "-");
+        } else {
+            printf("%-10d %14.0f %14.0f %16.0f\n", n + 1, rss, stats, (rss - first_rss) / n);
+        }
+    }
+    for (int n = 0; n < MEMORY_INSTANCES; n++) h.api->destroy_instance(insts[n]);
+    return 0;
+}
@@ -0,0 +1,72 @@
+/*
+ * Multitimbral comparison benchmark
+ *
+ * Plays the same two-track phrase through two standalone instances and
+ * through one mt_group pair, and prints render time per host cycle and
+ * the memory_stats totals of both tracks for each setup. Reports only;
+ * whether sharing the engine pays off depends on the patches.
+ *
+ *   mt_compare <module_dir> [cycles]
+ */
+
+#include "harness.h"
+
+#define COMPARE_CYCLES 2000
+#define NOTE_EVERY 50             /* host cycles between note changes */
+
+struct setup_result {
+    double cycle_us;              /* both tracks' render_blocks per cycle */
+    double memory_kb;             /* memory_stats total, both tracks */
+};
+
+static char g_buf[4096];
+
+static setup_result run_setup(harness *h, const char *defaults, int cycles) {
+    setup_result res = { 0.0, 0.0 };
+    void *tracks[2];
+    for (int t = 0; t < 2; t++) {
+        tracks[t] = harness_create(h, defaults);
+        if (!tracks[t]) exit(1);
+        /* Different presets on each track, as two real tracks would be */
+        harness_set_int(h, tracks[t], "preset", t * 7);
+    }
+
+    int16_t out[HARNESS_FRAMES * 2];
+    uint64_t total = 0;
+    for (int c = 0; c < cycles; c++) {
+        if (c % NOTE_EVERY == 0) {
+            int step = c / NOTE_EVERY;
+            for (int t = 0; t < 2; t++) {
+                int base = t ? 48 : 60;
+                if (step > 0) harness_note(h, tracks[t], base + (step - 1) % 12, 0);
+                harness_note(h, tracks[t], base + step % 12, 100);
+            }
+        }
+        uint64_t t0 = harness_now_ns();
+        for (int t = 0; t < 2; t++) h->api->render_block(tracks[t], out, HARNESS_FRAMES);
+        total += harness_now_ns() - t0;
+    }
+    res.cycle_us = (double)total / cycles / 1000.0;
+
+    for (int t = 0; t < 2; t++) {
+        h->api->get_param(tracks[t], "memory_stats", g_buf, sizeof(g_buf));
+        res.memory_kb += json_number(g_buf, "total", 0.0) / 1024.0;
+    }
+    for (int t = 0; t < 2; t++) h->api->destroy_instance(tracks[t]);
+    return res;
+}
+
+int main(int argc, char **argv) {
+    harness h;
+    if (!harness_init(&h, argc, argv)) return 1;
+    int cycles = argc > 2 ? atoi(argv[2]) : COMPARE_CYCLES;
+    if (cycles < 1) cycles = 1;
+
+    setup_result solo = run_setup(&h, "{}", cycles);
+    setup_result mt = run_setup(&h, "{\"mt_group\":1}", cycles);
+
+    printf("%-12s %14s %14s\n", "setup", "us / cycle", "memory KiB");
+    printf("%-12s %14.1f %14.0f\n", "standalone", solo.cycle_us, solo.memory_kb);
+    printf("%-12s %14.1f %14.0f\n", "mt_group", mt.cycle_us, mt.memory_kb);
+    return 0;
+}
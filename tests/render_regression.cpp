@@ -0,0 +1,315 @@
+/*
+ * Render regression test
+ *
+ * Renders a fixed MIDI phrase through an even spread of the factory
+ * presets, each on a fresh seeded instance, and compares against the
+ * golden file: the output hash must match, the spectral fingerprint
+ * (mean power per octave band) must stay within SPECTRUM_TOLERANCE_DB,
+ * and the average render_block time must stay within the stored budget.
+ *
+ *   render_regression <module_dir> <golden_file>            check
+ *   render_regression <module_dir> <golden_file> --update   rewrite
+ *
+ * Golden hashes are only valid for the Surge revision, compiler and
+ * architecture they were recorded with, so regenerate them with --update
+ * after changing any of those. --update renders each preset twice and
+ * records "-" instead of a hash when the two renders differ despite the
+ * seed (random sources Surge does not draw from a seeded generator). The
+ * fingerprint is still checked for those, and it tolerates the small
+ * float differences that change every hash.
+ */
+
+#include "harness.h"
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+#define REGRESSION_PRESETS 16
+#define PHRASE_BLOCKS 400
+#define BUDGET_FACTOR 3.0     /* budget written by --update, x measured avg */
+#define RENDER_SEED 1
+#define FFT_SIZE 1024
+#define SPECTRUM_BANDS 10
+#define SPECTRUM_FLOOR_DB -90.0   /* bands quieter than this in both renders are not compared */
+#define SPECTRUM_TOLERANCE_DB 3.0
+
+/* Octave band edges in Hz; the last band runs to Nyquist */
+static const double g_band_edges[SPECTRUM_BANDS] = {
+    0.0, 62.5, 125.0, 250.0, 500.0, 1000.0, 2000.0, 4000.0, 8000.0, 16000.0
+};
+
+struct golden_entry {
+    std::string name;
+    std::string hash;         /* "-" = not deterministic, no hash check */
+    double budget_us;
+    std::vector<double> bands;    /* dB per octave band, empty = not recorded */
+};
+
+struct render_result {
+    std::string name;
+    std::string hash;
+    double avg_us;
+    std::vector<double> bands;
+};
+
+/* Mean power per octave band of the mono sum, over Hann-windowed
+ * FFT_SIZE frames */
+struct spectrum {
+    std::vector<double> frame;
+    std::vector<double> power;
+    int fill = 0;
+    int frames = 0;
+
+    spectrum() : frame(FFT_SIZE), power(SPECTRUM_BANDS, 0.0) {}
+};
+
+static void fft(std::vector<double> &re, std::vector<double> &im) {
+    int n = (int)re.size();
+    for (int i = 1, j = 0; i < n; i++) {
+        int bit = n >> 1;
+        for (; j & bit; bit >>= 1) j ^= bit;
+        j ^= bit;
+        if (i < j) {
+            std::swap(re[i], re[j]);
+            std::swap(im[i], im[j]);
+        }
+    }
+    for (int len = 2; len <= n; len <<= 1) {
+        double ang = -2.0 * M_PI / len;
+        for (int i = 0; i < n; i += len) {
+            for (int k = 0; k < len / 2; k++) {
+                double wr = cos(ang * k), wi = sin(ang * k);
+                int a = i + k, b = i + k + len / 2;
+                double xr = re[b] * wr - im[b] * wi;
+                double xi = re[b] * wi + im[b] * wr;
+                re[b] = re[a] - xr;
+                im[b] = im[a] - xi;
+                re[a] += xr;
+                im[a] += xi;
+            }
+        }
+    }
+}
+
+static void spectrum_frame(spectrum *sp) {
+    std::vector<double> re(FFT_SIZE), im(FFT_SIZE, 0.0);
+    for (int i = 0; i < FFT_SIZE; i++) {
+        double w = 0.5 - 0.5 * cos(2.0 * M_PI * i / (FFT_SIZE - 1));
+        re[i] = sp->frame[i] * w;
+    }
+    fft(re, im);
+    for (int k = 1; k < FFT_SIZE / 2; k++) {
+        double hz = (double)k * HARNESS_SAMPLE_RATE / FFT_SIZE;
+        int band = SPECTRUM_BANDS - 1;
+        while (band > 0 && hz < g_band_edges[band]) band--;
+        sp->power[band] += re[k] * re[k] + im[k] * im[k];
+    }
+    sp->frames++;
+}
+
+static void spectrum_add(spectrum *sp, const int16_t *out, int frames) {
+    for (int i = 0; i < frames; i++) {
+        sp->frame[sp->fill++] = (out[i * 2] + out[i * 2 + 1]) / 65536.0;
+        if (sp->fill == FFT_SIZE) {
+            spectrum_frame(sp);
+            sp->fill = 0;
+        }
+    }
+}
+
+static std::vector<double> spectrum_db(const spectrum *sp) {
+    std::vector<double> db(SPECTRUM_BANDS);
+    for (int b = 0; b < SPECTRUM_BANDS; b++) {
+        double mean = sp->frames ? sp->power[b] / sp->frames : 0.0;
+        db[b] = mean > 0.0 ? 10.0 * log10(mean) : -200.0;
+        if (db[b] < -200.0) db[b] = -200.0;
+    }
+    return db;
+}
+
+/* Band index furthest outside the tolerance, or -1 */
+static int spectrum_mismatch(const std::vector<double> &golden, const std::vector<double> &now) {
+    int worst = -1;
+    double worst_diff = SPECTRUM_TOLERANCE_DB;
+    for (int b = 0; b < SPECTRUM_BANDS; b++) {
+        if (golden[b] < SPECTRUM_FLOOR_DB && now[b] < SPECTRUM_FLOOR_DB) continue;
+        double diff = fabs(golden[b] - now[b]);
+        if (diff > worst_diff) {
+            worst_diff = diff;
+            worst = b;
+        }
+    }
+    return worst;
+}
+
+/* Chord, release, then a single low note: covers attack, sustain,
+ * release tails and voice reuse */
+static void play_phrase(harness *h, void *inst, spectrum *sp) {
+    int16_t out[HARNESS_FRAMES * 2];
+    for (int block = 0; block < PHRASE_BLOCKS; block++) {
+        if (block == 0) {
+            harness_note(h, inst, 60, 100);
+            harness_note(h, inst, 64, 90);
+            harness_note(h, inst, 67, 80);
+        } else if (block == 150) {
+            harness_note(h, inst, 60, 0);
+            harness_note(h, inst, 64, 0);
+            harness_note(h, inst, 67, 0);
+        } else if (block == 170) {
+            harness_note(h, inst, 36, 110);
+        } else if (block == 300) {
+            harness_note(h, inst, 36, 0);
+        }
+        h->api->render_block(inst, out, HARNESS_FRAMES);
+        spectrum_add(sp, out, HARNESS_FRAMES);
+    }
+}
+
+static bool render_preset(harness *h, int preset, render_result *res) {
+    char defaults[32];
+    snprintf(defaults, sizeof(defaults), "{\"seed\":%d}", RENDER_SEED);
+    void *inst = harness_create(h, defaults);
+    if (!inst) return false;
+
+    char buf[512];
+    harness_set_int(h, inst, "preset", preset);
+    h->api->get_param(inst, "preset_name", buf, sizeof(buf));
+    res->name = buf;
+
+    spectrum sp;
+    h->api->set_param(inst, "render_stats_reset", "1");
+    play_phrase(h, inst, &sp);
+    h->api->get_param(inst, "render_stats", buf, sizeof(buf));
+    h->api->destroy_instance(inst);
+
+    const char *hash = strstr(buf, "\"hash\":\"");
+    res->hash = hash ? std::string(hash + 8, 8) : "";
+    res->avg_us = json_number(buf, "avg_us", 0.0);
+    res->bands = spectrum_db(&sp);
+    return !res->hash.empty();
+}
+
+static std::vector<golden_entry> read_golden(const char *path) {
+    std::vector<golden_entry> entries;
+    FILE *f = fopen(path, "r");
+    if (!f) return entries;
+
+    char line[512];
+    while (fgets(line, sizeof(line), f)) {
+        if (line[0] == '#' || line[0] == '\n') continue;
+        /* name<TAB>hash<TAB>budget_us[<TAB>band dB,...] */
+        char *tab1 = strchr(line, '\t');
+        char *tab2 = tab1 ? strchr(tab1 + 1, '\t') : nullptr;
+        if (!tab2) continue;
+        golden_entry e;
+        e.name.assign(line, tab1 - line);
+        e.hash.assign(tab1 + 1, tab2 - tab1 - 1);
+        e.budget_us = atof(tab2 + 1);
+        char *tab3 = strchr(tab2 + 1, '\t');
+        for (char *pos = tab3; pos && (int)e.bands.size() < SPECTRUM_BANDS; pos = strchr(pos, ',')) {
+            e.bands.push_back(atof(++pos));
+        }
+        if ((int)e.bands.size() != SPECTRUM_BANDS) e.bands.clear();
+        entries.push_back(e);
+    }
+    fclose(f);
+    return entries;
+}
+
+static bool write_golden(const char *path, const std::vector<golden_entry> &entries) {
+    FILE *f = fopen(path, "w");
+    if (!f) return false;
+    fprintf(f, "# Render regression golden data, written by render_regression --update.\n");
+    fprintf(f, "# preset name<TAB>output hash (- = not deterministic)<TAB>avg render_block budget in us"
+               "<TAB>mean power per octave band in dB, from 0 Hz\n");
+    for (const golden_entry &e : entries) {
+        fprintf(f, "%s\t%s\t%.1f\t", e.name.c_str(), e.hash.c_str(), e.budget_us);
+        for (int b = 0; b < SPECTRUM_BANDS; b++) fprintf(f, "%s%.1f", b ? "," : "", e.bands[b]);
+        fprintf(f, "\n");
+    }
+    fclose(f);
+    return true;
+}
+
+int main(int argc, char **argv) {
+    harness h;
+    if (!harness_init(&h, argc, argv) || argc < 3) return 1;
+    const char *golden_path = argv[2];
+    bool update = argc > 3 && strcmp(argv[3], "--update") == 0;
+
+    void *probe = harness_create(&h, "{}");
+    if (!probe) return 1;
+    int count = harness_get_int(&h, probe, "preset_count");
+    h.api->destroy_instance(probe);
+    if (count <= 0) {
+        fprintf(stderr, "no presets under %s/surge-data\n", h.module_dir);
+        return 1;
+    }
+
+    int n = count < REGRESSION_PRESETS ? count : REGRESSION_PRESETS;
+    std::vector<golden_entry> golden = read_golden(golden_path);
+    std::vector<golden_entry> updated;
+    int failures = 0, checked = 0;
+
+    for (int i = 0; i < n; i++) {
+        int preset = (int)((long)i * count / n);
+        render_result res;
+        if (!render_preset(&h, preset, &res)) {
+            fprintf(stderr, "preset %d: no render_stats\n", preset);
+            return 1;
+        }
+
+        if (update) {
+            render_result again;
+            if (!render_preset(&h, preset, &again)) return 1;
+            golden_entry e;
+            e.name = res.name;
+            e.hash = (again.hash == res.hash) ? res.hash : "-";
+            e.budget_us = (res.avg_us > again.avg_us ? res.avg_us : again.avg_us) * BUDGET_FACTOR;
+            e.bands = res.bands;
+            updated.push_back(e);
+            printf("%-32s %s avg %.1f us\n", res.name.c_str(), e.hash.c_str(), res.avg_us);
+            continue;
+        }
+
+        const golden_entry *g = nullptr;
+        for (const golden_entry &e : golden) {
+            if (e.name == res.name) { g = &e; break; }
+        }
+        if (!g) {
+            printf("%-32s %s avg %.1f us (no golden entry)\n",
+                   res.name.c_str(), res.hash.c_str(), res.avg_us);
+            continue;
+        }
+
+        checked++;
+        bool hash_ok = g->hash == "-" || g->hash == res.hash;
+        bool time_ok = res.avg_us <= g->budget_us;
+        int band = g->bands.empty() ? -1 : spectrum_mismatch(g->bands, res.bands);
+        printf("%-32s %s avg %.1f us budget %.1f us\n",
+               res.name.c_str(), res.hash.c_str(), res.avg_us, g->budget_us);
+        if (!hash_ok) printf("  hash mismatch, golden %s\n", g->hash.c_str());
+        if (band >= 0) {
+            printf("  spectrum differs from %.1f Hz up: %.1f dB, golden %.1f dB\n",
+                   g_band_edges[band], res.bands[band], g->bands[band]);
+        }
+        if (!time_ok) printf("  over budget\n");
+        if (!hash_ok || band >= 0 || !time_ok) failures++;
+    }
+
+    if (update) {
+        if (!write_golden(golden_path, updated)) {
+            fprintf(stderr, "could not write %s\n", golden_path);
+            return 1;
+        }
+        printf("wrote %d entries to %s\n", (int)updated.size(), golden_path);
+        return 0;
+    }
+    if (checked == 0) {
+        printf("no golden entries match this build's presets; run with --update to record them\n");
+        return HARNESS_SKIP;
+    }
+    printf("%d/%d presets checked, %d failed\n", checked, n, failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,84 @@
+/*
+ * Chord-spam voice stealing benchmark
+ *
+ * Plays a new four-note chord every few blocks, without releasing the
+ * previous ones, through a few factory presets, so every note-on past
+ * the polyphony limit has to steal. Runs each preset on a fresh instance
+ * with quiet_steal 0 (Surge's note-order stealing) and 1, and prints the
+ * average note-on and render_block times and the number of quiet steals,
+ * so the cost of the allocator's scan can be compared on the target.
+ * Reports only.
+ *
+ *   steal_bench <module_dir> [chords]
+ */
+
+#include "harness.h"
+
+#define STEAL_PRESETS 8
+#define STEAL_CHORDS 400
+#define CHORD_NOTES 4
+#define BLOCKS_PER_CHORD 4
+
+struct steal_result {
+    double note_ns;           /* per note-on */
+    double render_us;         /* per render_block */
+    long steals;
+};
+
+static steal_result spam_chords(harness *h, int preset, int quiet, int chords, char *name, int name_len) {
+    steal_result res = { 0.0, 0.0, 0 };
+    void *inst = harness_create(h, "{}");
+    if (!inst) exit(1);
+    harness_set_int(h, inst, "preset", preset);
+    harness_set_int(h, inst, "quiet_steal", quiet);
+    h->api->get_param(inst, "preset_name", name, name_len);
+
+    int16_t out[HARNESS_FRAMES * 2];
+    uint64_t note_ns = 0;
+    h->api->set_param(inst, "render_stats_reset", "1");
+    for (int c = 0; c < chords; c++) {
+        int root = 36 + (c * 7) % 36;
+        uint64_t t0 = harness_now_ns();
+        for (int n = 0; n < CHORD_NOTES; n++) harness_note(h, inst, root + n * 4, 100);
+        note_ns += harness_now_ns() - t0;
+        for (int b = 0; b < BLOCKS_PER_CHORD; b++) h->api->render_block(inst, out, HARNESS_FRAMES);
+    }
+
+    char buf[512];
+    h->api->get_param(inst, "render_stats", buf, sizeof(buf));
+    res.render_us = json_number(buf, "avg_us", 0.0);
+    h->api->get_param(inst, "voice_stats", buf, sizeof(buf));
+    res.steals = (long)json_number(buf, "steals", 0.0);
+    res.note_ns = (double)note_ns / ((double)chords * CHORD_NOTES);
+    h->api->destroy_instance(inst);
+    return res;
+}
+
+int main(int argc, char **argv) {
+    harness h;
+    if (!harness_init(&h, argc, argv)) return 1;
+    int chords = argc > 2 ? atoi(argv[2]) : STEAL_CHORDS;
+    if (chords < 1) chords = 1;
+
+    void *probe = harness_create(&h, "{}");
+    if (!probe) return 1;
+    int count = harness_get_int(&h, probe, "preset_count");
+    h.api->destroy_instance(probe);
+    if (count <= 0) {
+        fprintf(stderr, "no presets under %s/surge-data\n", h.module_dir);
+        return 1;
+    }
+
+    int n = count < STEAL_PRESETS ? count : STEAL_PRESETS;
+    printf("%-32s %12s %12s %12s %12s %10s\n", "preset", "note ns (0)", "note ns (1)",
+           "us (0)", "us (1)", "steals");
+    for (int i = 0; i < n; i++) {
+        int preset = (int)((long)i * count / n);
+        char name[128];
+        steal_result off = spam_chords(&h, preset, 0, chords, name, sizeof(name));
+        steal_result on = spam_chords(&h, preset, 1, chords, name, sizeof(name));
+        printf("%-32s %12.0f %12.0f %12.1f %12.1f %10ld\n", name, off.note_ns, on.note_ns,
+               off.render_us, on.render_us, on.steals);
+    }
+    return 0;
+}
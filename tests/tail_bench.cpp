@@ -0,0 +1,80 @@
+/*
+ * Silent-tail benchmark
+ *
+ * Plays a short chord through a few factory presets, releases it and
+ * renders a long stretch of silence, once with ftz off and once with it
+ * on, each on a fresh instance. Prints the average render_block time over
+ * the tail and the denormal_stats count for both, so the cost of
+ * subnormal filter, delay and reverb tails can be compared on the target.
+ * Reports only.
+ *
+ *   tail_bench <module_dir> [tail_blocks]
+ */
+
+#include "harness.h"
+
+#define TAIL_PRESETS 8
+#define TAIL_BLOCKS 3000          /* ~8.7 s of host blocks at 44.1 kHz */
+#define NOTE_BLOCKS 100
+
+struct tail_result {
+    double avg_us;
+    long subnormals;
+};
+
+static tail_result render_tail(harness *h, int preset, int ftz, int tail_blocks, char *name, int name_len) {
+    tail_result res = { 0.0, 0 };
+    void *inst = harness_create(h, "{}");
+    if (!inst) exit(1);
+    harness_set_int(h, inst, "preset", preset);
+    harness_set_int(h, inst, "ftz", ftz);
+    h->api->get_param(inst, "preset_name", name, name_len);
+
+    int16_t out[HARNESS_FRAMES * 2];
+    harness_note(h, inst, 48, 120);
+    harness_note(h, inst, 55, 120);
+    harness_note(h, inst, 64, 120);
+    for (int b = 0; b < NOTE_BLOCKS; b++) h->api->render_block(inst, out, HARNESS_FRAMES);
+    harness_note(h, inst, 48, 0);
+    harness_note(h, inst, 55, 0);
+    harness_note(h, inst, 64, 0);
+
+    /* Time only the tail */
+    h->api->set_param(inst, "render_stats_reset", "1");
+    for (int b = 0; b < tail_blocks; b++) h->api->render_block(inst, out, HARNESS_FRAMES);
+
+    char buf[512];
+    h->api->get_param(inst, "render_stats", buf, sizeof(buf));
+    res.avg_us = json_number(buf, "avg_us", 0.0);
+    h->api->get_param(inst, "denormal_stats", buf, sizeof(buf));
+    res.subnormals = (long)json_number(buf, "subnormals", 0.0);
+    h->api->destroy_instance(inst);
+    return res;
+}
+
+int main(int argc, char **argv) {
+    harness h;
+    if (!harness_init(&h, argc, argv)) return 1;
+    int tail_blocks = argc > 2 ? atoi(argv[2]) : TAIL_BLOCKS;
+    if (tail_blocks < 1) tail_blocks = 1;
+
+    void *probe = harness_create(&h, "{}");
+    if (!probe) return 1;
+    int count = harness_get_int(&h, probe, "preset_count");
+    h.api->destroy_instance(probe);
+    if (count <= 0) {
+        fprintf(stderr, "no presets under %s/surge-data\n", h.module_dir);
+        return 1;
+    }
+
+    int n = count < TAIL_PRESETS ? count : TAIL_PRESETS;
+    printf("%-32s %12s %12s %12s\n", "preset", "us (ftz 0)", "us (ftz 1)", "subnormals");
+    for (int i = 0; i < n; i++) {
+        int preset = (int)((long)i * count / n);
+        char name[128];
+        tail_result off = render_tail(&h, preset, 0, tail_blocks, name, sizeof(name));
+        tail_result on = render_tail(&h, preset, 1, tail_blocks, name, sizeof(name));
+        printf("%-32s %12.1f %12.1f %12ld\n", name, off.avg_us, on.avg_us, off.subnormals);
+    }
+    return 0;
+}
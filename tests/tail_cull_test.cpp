@@ -0,0 +1,103 @@
+/*
+ * Release tail culling test
+ *
+ * Plays a chord through an even spread of the factory presets, releases
+ * it and renders the tail, on fresh seeded instances with tail_cull off
+ * and on. Culling may only remove what the int16 output cannot carry, so
+ * the two renders must match to within TAIL_TOLERANCE_LSB at every
+ * sample. Presets whose output differs between two identical renders
+ * with culling off are reported and not compared.
+ *
+ *   tail_cull_test <module_dir> [presets]
+ */
+
+#include "harness.h"
+
+#include <vector>
+
+#define TAIL_PRESETS 16
+#define NOTE_BLOCKS 100
+#define TAIL_BLOCKS 1500          /* ~4.4 s of host blocks at 44.1 kHz */
+#define TAIL_TOLERANCE_LSB 2      /* one culled voice stays under 0.5 LSB; allow a few at once */
+
+static std::vector<int16_t> render_tail(harness *h, int preset, int cull, long *culled,
+                                        char *name, int name_len) {
+    std::vector<int16_t> pcm;
+    void *inst = harness_create(h, "{\"seed\":1}");
+    if (!inst) exit(1);
+    harness_set_int(h, inst, "preset", preset);
+    harness_set_int(h, inst, "tail_cull", cull);
+    h->api->get_param(inst, "preset_name", name, name_len);
+
+    int16_t out[HARNESS_FRAMES * 2];
+    pcm.reserve((size_t)(NOTE_BLOCKS + TAIL_BLOCKS) * HARNESS_FRAMES * 2);
+    static const int chord[] = { 48, 55, 60, 64, 67 };
+    for (int note : chord) harness_note(h, inst, note, 110);
+    for (int b = 0; b < NOTE_BLOCKS + TAIL_BLOCKS; b++) {
+        if (b == NOTE_BLOCKS) {
+            for (int note : chord) harness_note(h, inst, note, 0);
+        }
+        h->api->render_block(inst, out, HARNESS_FRAMES);
+        pcm.insert(pcm.end(), out, out + HARNESS_FRAMES * 2);
+    }
+
+    char buf[512];
+    h->api->get_param(inst, "voice_stats", buf, sizeof(buf));
+    *culled = (long)json_number(buf, "tails_culled", 0.0);
+    h->api->destroy_instance(inst);
+    return pcm;
+}
+
+int main(int argc, char **argv) {
+    harness h;
+    if (!harness_init(&h, argc, argv)) return 1;
+    int presets = argc > 2 ? atoi(argv[2]) : TAIL_PRESETS;
+    if (presets < 1) presets = 1;
+
+    void *probe = harness_create(&h, "{}");
+    if (!probe) return 1;
+    int count = harness_get_int(&h, probe, "preset_count");
+    h.api->destroy_instance(probe);
+    if (count <= 0) {
+        fprintf(stderr, "no presets under %s/surge-data\n", h.module_dir);
+        return 1;
+    }
+
+    int n = count < presets ? count : presets;
+    int failures = 0, compared = 0;
+    for (int i = 0; i < n; i++) {
+        int preset = (int)((long)i * count / n);
+        char name[128];
+        long culled = 0, unused = 0;
+        std::vector<int16_t> plain = render_tail(&h, preset, 0, &unused, name, sizeof(name));
+        std::vector<int16_t> again = render_tail(&h, preset, 0, &unused, name, sizeof(name));
+        if (plain != again) {
+            printf("%-32s not deterministic, not compared\n", name);
+            continue;
+        }
+        std::vector<int16_t> cull = render_tail(&h, preset, 1, &culled, name, sizeof(name));
+
+        int worst = 0;
+        size_t worst_at = 0;
+        for (size_t s = 0; s < plain.size(); s++) {
+            int diff = abs((int)plain[s] - (int)cull[s]);
+            if (diff > worst) {
+                worst = diff;
+                worst_at = s;
+            }
+        }
+        compared++;
+        bool ok = worst <= TAIL_TOLERANCE_LSB;
+        printf("%-32s %3ld tails culled, max difference %d LSB", name, culled, worst);
+        if (!ok) printf(" at frame %zu FAILED", worst_at / 2);
+        printf("\n");
+        if (!ok) failures++;
+    }
+
+    if (compared == 0) {
+        printf("no deterministic presets to compare\n");
+        return HARNESS_SKIP;
+    }
+    printf("%d/%d presets compared, %d failed\n", compared, n, failures);
+    return failures ? 1 : 0;
+}